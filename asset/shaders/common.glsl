@@ -1,10 +1,15 @@
 #version 450 core
 
 // UNIFORMS
-uniform float master_time;
-uniform vec2 camera;
-uniform vec2 output_resolution;
-uniform vec2 native_resolution;
+// Engine globals, written once per frame (and per render target) into a uniform buffer instead of being set
+// on every program. Must match FrameGlobals in draw.hpp.
+layout (std140, binding = 0) uniform FrameGlobals {
+	mat4 projection;
+	vec2 camera;
+	vec2 output_resolution;
+	vec2 native_resolution;
+	float master_time;
+};
 
 //const vec2 output_resolution = vec2(1920.0, 1080.0) * vec2(.0375, .125);  
 
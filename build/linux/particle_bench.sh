@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds the headless particle benchmark (src/bench/particle_bench.cpp). Pass the number of frames per scenario
+# to the binary; it prints one JSON object per scenario.
+set -e
+
+cd "$(dirname "$0")/../.."
+mkdir -p bin
+${CXX:-g++} -std=c++20 -O2 -g -I include -I src src/bench/particle_bench.cpp -o bin/particle_bench -lpthread
+echo "built bin/particle_bench"
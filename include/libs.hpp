@@ -2,6 +2,7 @@
 #define NOMINMAX
 #include "windows.h"
 #include "shlobj.h"
+#include <immintrin.h>
 
 // Library includes
 #include "glad/glad.h"
@@ -55,10 +56,12 @@ extern "C" {
 #include <algorithm>
 #include <array>
 #include <assert.h>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <ctime>
 #include <codecvt>
+#include <condition_variable>
 #include <csignal>
 #include <cstdint>
 #include <cstdlib>
@@ -238,6 +238,9 @@ void render_imgui();
 typedef enum {
     VertexAttributeKind_Float,
     VertexAttributeKind_U32,
+    VertexAttributeKind_U8Normalized,
+    VertexAttributeKind_U16Normalized,
+    VertexAttributeKind_Half,
 } VertexAttributeKind;
 
 typedef enum {
@@ -257,6 +260,7 @@ typedef enum {
 	UniformKind_Texture = 100,
 	UniformKind_PipelineOutput = 101,
 	UniformKind_RenderTarget = 102,
+	UniformKind_TextureArray = 103,
 } UniformKind;
 
 typedef enum {
@@ -291,9 +295,12 @@ typedef enum {
 
 
 typedef struct GpuShader GpuShader;
+typedef u32 GpuShaderHandle;
+typedef u32 GpuRenderTargetHandle;
 typedef struct GpuBuffer GpuBuffer;
 typedef struct GpuVertexLayout GpuVertexLayout;
 typedef struct GpuCommandBufferBatched GpuCommandBufferBatched;
+typedef struct GpuInstanceBatch GpuInstanceBatch;
 typedef struct DrawCall DrawCall;
 
 typedef struct {
@@ -343,8 +350,40 @@ typedef struct {
 	u32 num_vertex_attributes;
   u32 max_vertices;
   u32 max_draw_calls;
+  u32 max_uniforms;
+  u32 vertices_per_chunk;
+  bool persistent;
+  bool indexed_quads;
+  bool packed_vertices;
+  bool texture_arrays;
+  bool cull;
 } GpuCommandBufferBatchedDescriptor;
 
+typedef struct {
+  i32 layer;
+  u32 draw_calls;
+} GpuLayerStats;
+
+typedef struct {
+  u32 draw_calls_recorded;
+  u32 draw_calls_submitted;
+  bool sorted;
+  u32 num_layers;
+  GpuLayerStats layers [16];
+  u32 vertices_high_water;
+  u32 max_vertices;
+  u32 vertex_chunks;
+  u32 draw_calls_high_water;
+  u32 max_draw_calls;
+  u32 primitives_kept;
+  u32 primitives_culled;
+} GpuCommandBufferStats;
+
+typedef struct {
+  u32 issued;
+  u32 skipped;
+} GlCallCounts;
+
 typedef struct {
   GpuBufferKind kind;
   GpuBufferUsage usage;
@@ -362,9 +401,22 @@ typedef struct {
 	u32 num_buffer_layouts;
 } GpuVertexLayoutDescriptor;
 
+typedef struct {
+	VertexAttribute* instance_attributes;
+	u32 num_instance_attributes;
+	u32 max_instances;
+	u32 vertices_per_instance;
+} GpuInstanceBatchDescriptor;
+
 GpuShader*               gpu_shader_create(GpuShaderDescriptor descriptor);
+GpuShader*               gpu_shader_find(const char* name);
+GpuShaderHandle          gpu_shader_find_handle(const char* name);
+GpuShaderHandle          gpu_shader_get_handle(GpuShader* shader);
+GpuShader*               gpu_shader_from_handle(GpuShaderHandle handle);
 GpuRenderTarget*         gpu_render_target_create(GpuRenderTargetDescriptor descriptor);
 GpuRenderTarget*         gpu_acquire_swapchain();
+GpuRenderTargetHandle    gpu_render_target_get_handle(GpuRenderTarget* target);
+GpuRenderTarget*         gpu_render_target_from_handle(GpuRenderTargetHandle handle);
 void                     gpu_render_target_bind(GpuRenderTarget* target);
 void                     gpu_render_target_clear(GpuRenderTarget* target);
 void                     gpu_render_target_blit(GpuRenderTarget* source, GpuRenderTarget* destination);
@@ -375,10 +427,14 @@ DrawCall*                gpu_command_buffer_find_draw_call(GpuCommandBufferBatch
 DrawCall*                gpu_command_buffer_flush_draw_call(GpuCommandBufferBatched* command_buffer);
 u8*                      gpu_command_buffer_alloc_vertex_data(GpuCommandBufferBatched* command_buffer, u32 count);
 u8*                      gpu_command_buffer_push_vertex_data(GpuCommandBufferBatched* command_buffer, void* data, u32 count);
+u8*                      gpu_command_buffer_alloc_quad_data(GpuCommandBufferBatched* command_buffer, u32 count);
+u8*                      gpu_command_buffer_alloc_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count);
 void                     gpu_command_buffer_bind(GpuCommandBufferBatched* command_buffer);
 void                     gpu_command_buffer_preprocess(GpuCommandBufferBatched* command_buffer);
 void                     gpu_command_buffer_render(GpuCommandBufferBatched* command_buffer);
 void                     gpu_command_buffer_submit(GpuCommandBufferBatched* command_buffer);
+GpuCommandBufferStats    gpu_command_buffer_check_stats(GpuCommandBufferBatched* command_buffer);
+GlCallCounts             gpu_check_gl_calls();
 GpuGraphicsPipeline*     gpu_graphics_pipeline_create(GpuGraphicsPipelineDescriptor descriptor);
 void                     gpu_graphics_pipeline_begin_frame(GpuGraphicsPipeline* pipeline);
 void                     gpu_graphics_pipeline_bind(GpuGraphicsPipeline* pipeline);
@@ -392,11 +448,13 @@ void                     gpu_buffer_sync(GpuBuffer* buffer, void* data, u32 size
 void                     gpu_buffer_sync_subdata(GpuBuffer* buffer, void* data, u32 byte_size, u32 byte_offset);
 void                     gpu_buffer_zero(GpuBuffer* buffer, u32 size);
 GpuVertexLayout*         gpu_vertex_layout_create(GpuVertexLayoutDescriptor descriptor);
+GpuInstanceBatch*        gpu_instance_batch_create(GpuInstanceBatchDescriptor descriptor);
 
 void                     gpu_dispatch_compute(GpuBuffer* buffer, u32 size);
     
 void                     set_active_shader(const char* name);
 void                     set_active_shader_ex(GpuShader* shader);
+void                     set_active_shader_handle(GpuShaderHandle handle);
 void                     set_uniform_texture(const char* name, i32 value);
 void                     set_uniform_i32(const char* name, i32 value);
 void                     set_uniform_f32(const char* name, float value);
@@ -465,14 +523,11 @@ typedef struct {
 
 typedef struct {
   Vector2 position;
-  Vector2 uv;
-} SdfVertex;
-
-typedef struct {
-  Vector2 position;
-  Vector3 color;
+  Vector2 size;
+  u32 color;
   float rotation;
-  u32 shape_index;
+  float edge_thickness;
+  u32 shape;
 } SdfInstance;
 
 typedef struct {
@@ -481,14 +536,16 @@ typedef struct {
   float edge_thickness;
 } SdfCircle;
 
-void gpu_render_sdf(GpuCommandBufferBatched* command_buffer, GpuVertexLayout* vertex_layout, u32 num_instances);
 
 
 void draw_quad(Vector2 position, Vector2 size, Vector4 color);
 void draw_line(Vector2 start, Vector2 end, f32 thickness, Vector4 color);
 void draw_circle(f32 px, f32 py, f32 radius, Vector4 color);
 void draw_circle_sdf(f32 px, f32 py, f32 radius, Vector4 color, f32 edge_thickness);
+void set_circle_sdf_radius(f32 radius);
 void draw_ring_sdf(f32 px, f32 py, f32 inner_radius, f32 radius, Vector4 color, f32 edge_thickness);
+void draw_box_sdf(f32 px, f32 py, f32 dx, f32 dy, Vector4 color, f32 edge_thickness);
+void draw_oriented_box_sdf(Vector2 start, Vector2 end, f32 thickness, Vector4 color, f32 edge_thickness);
 void draw_image(const char* name, f32 px, f32 py);
 void draw_image_size(const char* name, f32 px, f32 py, f32 dx, f32 dy);
 void draw_image_ex(const char* name, float px, float py, float dx, float dy, float opacity);
@@ -497,6 +554,7 @@ void draw_text(const char* text, f32 px, f32 py);
 void draw_text_ex(const char* text, f32 px, f32 py, Vector4 color, const char* font, f32 wrap);
 
 u32 find_texture_handle(const char* name);
+void enable_texture_arrays();
 
 //
 // OS
@@ -591,6 +649,46 @@ typedef enum {
 	ParticlePositionMode_Bottom,
 } ParticlePositionMode;
 
+typedef enum {
+	ParticleWarmupMode_Simulate,
+	ParticleWarmupMode_Scatter,
+} ParticleWarmupMode;
+
+typedef struct {
+	ParticleKind particle_kind;
+	Vector2 size;
+	float radius;
+	const char* sprite;
+	Vector4 color;
+	ParticlePositionMode position_mode;
+	Vector2 position;
+	Vector2 area;
+	i32 layer;
+	u32 capacity;
+	int max_spawn;
+	float spawn_rate;
+	float lifetime;
+	InterpolationFn velocity_fn;
+	Vector2 velocity_base;
+	Vector2 velocity_max;
+	Vector2 velocity_jitter;
+	bool jitter_base_velocity;
+	bool jitter_max_velocity;
+	float size_jitter;
+	bool jitter_size;
+	float master_opacity;
+	float opacity_jitter;
+	bool jitter_opacity;
+	bool opacity_interpolate_active;
+	float opacity_interpolate_time;
+	float opacity_interpolate_target;
+	i32 warmup_iter;
+	ParticleWarmupMode warmup_mode;
+	Vector2 gravity_source;
+	float gravity_intensity;
+	bool gravity_enabled;
+} ParticleSystemDescriptor;
+
 typedef struct {
 	i32 index;
 	i32 generation;
@@ -600,8 +698,21 @@ typedef struct {
 	int spawned;
 	int despawned;
 	int alive;
+	u32 capacity;
+	bool out_of_budget;
 } ParticleSystemFrame;
 
+typedef struct {
+	u32 bytes_budget;
+	u32 bytes_resident;
+	u32 bytes_in_use;
+	u32 blocks_in_use;
+	u32 blocks_cached;
+	u32 allocations;
+	u32 reuses;
+	u32 failures;
+} ParticlePoolStats;
+
 ParticleSystemHandle make_particle_system();
 void free_particle_system(ParticleSystemHandle system);
 ParticleSystemFrame check_particle_system(ParticleSystemHandle handle);
@@ -609,11 +720,18 @@ void stop_particle_emission(ParticleSystemHandle handle);
 void start_particle_emission(ParticleSystemHandle handle);
 void clear_particles(ParticleSystemHandle handle);
 void update_particles(ParticleSystemHandle handle);
+void update_all_particles();
 void draw_particles(ParticleSystemHandle handle);
 void stop_all_particles();
+ParticlePoolStats check_particle_pool();
+void set_particle_budget(u32 bytes);
+void trim_particle_pool();
+void apply_particle_descriptor(ParticleSystemHandle handle, ParticleSystemDescriptor* descriptor);
+void read_particle_descriptor(ParticleSystemHandle handle, ParticleSystemDescriptor* descriptor);
 
 void set_particle_lifetime(ParticleSystemHandle system, float lifetime);
 void set_particle_max_spawn(ParticleSystemHandle handle, int max_spawn);
+void set_particle_capacity(ParticleSystemHandle handle, u32 capacity);
 void set_particle_spawn_rate(ParticleSystemHandle handle, float spawn_rate);
 void set_particle_size(ParticleSystemHandle handle, float x, float y);
 void set_particle_radius(ParticleSystemHandle handle, float r);
@@ -637,6 +755,7 @@ void set_particle_jitter_opacity(ParticleSystemHandle handle, bool jitter);
 void set_particle_opacity_interpolation(ParticleSystemHandle handle, bool active, float start_time, float interpolate_to);
 void set_particle_warm(ParticleSystemHandle system, bool warm);
 void set_particle_warmup(ParticleSystemHandle system, i32 warmup);
+void set_particle_warmup_mode(ParticleSystemHandle handle, ParticleWarmupMode mode);
 void set_particle_gravity_source(ParticleSystemHandle handle, float x, float y);
 void set_particle_gravity_intensity(ParticleSystemHandle handle, float intensity);
 void set_particle_gravity_enabled(ParticleSystemHandle handle, bool enabled);
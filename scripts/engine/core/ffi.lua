@@ -53,6 +53,14 @@ function tdengine.ffi.init()
 		}
 	)
 
+	tdengine.enum.define(
+		'ParticleWarmupMode',
+		{
+			Simulate = tdengine.ffi.ParticleWarmupMode_Simulate,
+			Scatter = tdengine.ffi.ParticleWarmupMode_Scatter,
+		}
+	)
+
 	tdengine.enum.define(
 		'BlendMode',
 		{
@@ -129,6 +137,7 @@ function tdengine.ffi.init()
 			Texture        = tdengine.ffi.UniformKind_Texture,
 			PipelineOutput = tdengine.ffi.UniformKind_PipelineOutput,
 			RenderTarget   = tdengine.ffi.UniformKind_RenderTarget,
+			TextureArray   = tdengine.ffi.UniformKind_TextureArray,
 			Enum = 201,
 		}
 	)
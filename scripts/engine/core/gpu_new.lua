@@ -12,10 +12,11 @@ GpuBufferLayout = tdengine.class.metatype('GpuBufferLayout')
 function GpuBufferLayout:init(params)
   local allocator = tdengine.ffi.ma_find('bump')
 
-  self.num_vertex_attributes = #params.vertex_attributes
+  local vertex_attributes = params.vertex_attributes or {}
+  self.num_vertex_attributes = #vertex_attributes
   self.vertex_attributes = allocator:alloc_array('VertexAttribute', self.num_vertex_attributes)
   for i = 1, self.num_vertex_attributes, 1 do
-    self.vertex_attributes[i - 1] = VertexAttribute:new(params.vertex_attributes[i])
+    self.vertex_attributes[i - 1] = VertexAttribute:new(vertex_attributes[i])
   end
 
   self.buffer = params.buffer
@@ -64,11 +65,19 @@ function GpuCommandBufferBatchedDescriptor:init(params)
 
   self.max_vertices = params.max_vertices
   self.max_draw_calls = params.max_draw_calls
-
-  self.num_vertex_attributes = #params.vertex_attributes
+  self.max_uniforms = params.max_uniforms or 0
+  self.vertices_per_chunk = params.vertices_per_chunk or 0
+  self.persistent = params.persistent or false
+  self.indexed_quads = params.indexed_quads or false
+  self.packed_vertices = params.packed_vertices or false
+  self.texture_arrays = params.texture_arrays or false
+  self.cull = params.cull or false
+
+  local vertex_attributes = params.vertex_attributes or {}
+  self.num_vertex_attributes = #vertex_attributes
   self.vertex_attributes = allocator:alloc_array('VertexAttribute', self.num_vertex_attributes)
   for i = 1, self.num_vertex_attributes, 1 do
-    self.vertex_attributes[i - 1] = VertexAttribute:new(params.vertex_attributes[i])
+    self.vertex_attributes[i - 1] = VertexAttribute:new(vertex_attributes[i])
   end
 end
 
@@ -248,6 +257,17 @@ function tdengine.gpus.init()
   self.shaders = {}
   self.resolutions = {}
   self.draw_configurations = {}
+
+  -- Resources are keyed by their enum's number, so finding one never builds a string
+  self.resource_maps = {
+    RenderTarget = self.render_targets,
+    GraphicsPipeline = self.graphics_pipelines,
+    CommandBuffer = self.command_buffers,
+    Buffer = self.buffers,
+    Shader = self.shaders,
+    Resolution = self.resolutions,
+    DrawConfiguration = self.draw_configurations,
+  }
 end
 
 function tdengine.gpus.update()
@@ -299,39 +319,40 @@ function tdengine.gpus.find(id)
     return nil
   end
 
-  local resource_map
-  if tdengine.enums.RenderTarget:match(id) then
-    resource_map = self.render_targets
-  elseif tdengine.enums.GraphicsPipeline:match(id) then
-    resource_map = self.graphics_pipelines
-  elseif tdengine.enums.CommandBuffer:match(id) then
-    resource_map = self.command_buffers
-  elseif tdengine.enums.Buffer:match(id) then
-    resource_map = self.buffers
-  elseif tdengine.enums.Shader:match(id) then
-    resource_map = self.shaders
-  elseif tdengine.enums.Resolution:match(id) then
-    resource_map = self.resolutions
-  elseif tdengine.enums.DrawConfiguration:match(id) then
-    resource_map = self.draw_configurations
-  end
+  -- Serialized enums don't carry their methods
+  if not id.to_number then id = tdengine.enum.load(id) end
 
-  local string_id = tdengine.enum.load(id):to_string()
-  local resource = resource_map[string_id]
+  local resource_map = self.resource_maps[id.__enum]
+  local resource = resource_map and resource_map[id:to_number()]
   if not resource then
     dbg()
-    log.warn('Could not find GPU resource; id = %s', string_id)
+    log.warn('Could not find GPU resource; id = %s', id:to_qualified_string())
   end
 
   return resource
 end
 
+-- Shaders and render targets also have integer handles on the engine side, for the handle-based draw APIs
+function tdengine.gpus.find_handle(id)
+  local resource = self.find(id)
+  if not resource then return 0 end
+
+  if tdengine.enums.Shader:match(id) then
+    return tdengine.ffi.gpu_shader_get_handle(resource)
+  elseif tdengine.enums.RenderTarget:match(id) then
+    return tdengine.ffi.gpu_render_target_get_handle(resource)
+  end
+
+  log.warn('GPU resource has no handle; id = %s', tostring(id))
+  return 0
+end
+
 
 -------------------
 -- RENDER TARGET -- 
 -------------------
 function tdengine.gpus.add_render_target(id, descriptor)
-  self.render_targets[id:to_string()] = tdengine.ffi.gpu_render_target_create(descriptor)
+  self.render_targets[id:to_number()] = tdengine.ffi.gpu_render_target_create(descriptor)
 end
 
 function tdengine.gpus.add_render_targets(targets)
@@ -347,7 +368,7 @@ end
 -- GRAPHICS PIPELINE --
 -----------------------
 function tdengine.gpus.add_graphics_pipeline(id, descriptor)
-  self.graphics_pipelines[id:to_string()] = tdengine.ffi.gpu_graphics_pipeline_create(descriptor)
+  self.graphics_pipelines[id:to_number()] = tdengine.ffi.gpu_graphics_pipeline_create(descriptor)
 end
 
 function tdengine.gpus.add_graphics_pipelines(pipelines)
@@ -363,7 +384,7 @@ end
 -- COMMAND BUFFER --
 --------------------
 function tdengine.gpus.add_command_buffer(id, descriptor)
-  self.command_buffers[id:to_string()] = tdengine.ffi.gpu_create_command_buffer(descriptor)
+  self.command_buffers[id:to_number()] = tdengine.ffi.gpu_create_command_buffer(descriptor)
 end
 
 function tdengine.gpus.add_command_buffers(command_buffers)
@@ -379,7 +400,7 @@ end
 -- GPU BUFFER --
 ----------------
 function tdengine.gpus.add_buffer(id, descriptor)
-  self.buffers[id:to_string()] = tdengine.ffi.gpu_buffer_create(descriptor)
+  self.buffers[id:to_number()] = tdengine.ffi.gpu_buffer_create(descriptor)
 end
 
 function tdengine.gpus.add_buffers(buffers)
@@ -392,7 +413,7 @@ end
 -- SHADER --
 ------------
 function tdengine.gpus.add_shader(id, descriptor)
-  self.shaders[id:to_string()] = tdengine.ffi.gpu_shader_create(descriptor)
+  self.shaders[id:to_number()] = tdengine.ffi.gpu_shader_create(descriptor)
 end
 
 function tdengine.gpus.add_shaders(shaders)
@@ -408,7 +429,7 @@ end
 -- RESOLUTION --
 ----------------
 function tdengine.gpus.add_resolution(id, size)
-  self.resolutions[id:to_string()] = Vector2:new(size.x, size.y)
+  self.resolutions[id:to_number()] = Vector2:new(size.x, size.y)
 end
 
 function tdengine.gpus.add_resolutions(resolutions)
@@ -421,7 +442,7 @@ end
 -- SHADER --
 ------------
 function tdengine.gpus.add_draw_configuration(id, draw_configuration)
-  self.draw_configurations[id:to_string()] = draw_configuration
+  self.draw_configurations[id:to_number()] = draw_configuration
 end
 
 function tdengine.gpus.add_draw_configurations(draw_configurations)
@@ -3,6 +3,7 @@ local self = tdengine.time_metric
 function tdengine.time_metric.init(name)
   self.metrics = tdengine.data_types.Array:new()
   self.metrics:add('frame') -- Created in C, so we don't need to check for its existence just for the first frame
+  self.metrics:add('particle_warmup') -- Also created in C; only sampled on frames where a particle system warms up
   self.add('update')
   self.add('render')
 
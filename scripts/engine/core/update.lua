@@ -18,6 +18,8 @@ function tdengine.update_game(dt)
   tdengine.audio.update()
 
   tdengine.lifecycle.run_callback(tdengine.lifecycle.callbacks.on_end_frame)
+
+  tdengine.ffi.update_all_particles()
   
   tdengine.ffi.tm_end('update')
 
@@ -304,6 +304,54 @@ function EngineStats:engine_viewer()
 	end
 
 	if imgui.TreeNode('GPU') then
+		if imgui.TreeNode('Draw Calls') then
+			local draw_calls = {}
+			local layers = {}
+			local storage = {}
+			local culling = {}
+			for id, command_buffer in pairs(tdengine.gpus.command_buffers) do
+				local name = CommandBuffer(id):to_string()
+				local stats = tdengine.ffi.gpu_command_buffer_check_stats(command_buffer)
+				draw_calls[name] = string.format('%d recorded, %d submitted%s', stats.draw_calls_recorded, stats.draw_calls_submitted, stats.sorted and ' (sorted)' or '')
+				storage[name] = string.format('%d / %d vertices (%d chunks), %d / %d draw calls', stats.vertices_high_water, stats.max_vertices, stats.vertex_chunks, stats.draw_calls_high_water, stats.max_draw_calls)
+				culling[name] = string.format('%d kept, %d culled', stats.primitives_kept, stats.primitives_culled)
+
+				if stats.num_layers > 0 then
+					layers[name] = {}
+					for i = 0, stats.num_layers - 1 do
+						local layer = stats.layers[i]
+						layers[name][string.format('layer %d', layer.layer)] = layer.draw_calls
+					end
+				end
+			end
+			imgui.extensions.Table(draw_calls)
+
+			if imgui.TreeNode('Per Layer') then
+				imgui.extensions.Table(layers)
+				imgui.TreePop()
+			end
+
+			if imgui.TreeNode('High Water') then
+				imgui.extensions.Table(storage)
+				imgui.TreePop()
+			end
+
+			if imgui.TreeNode('Culling') then
+				imgui.extensions.Table(culling)
+				imgui.TreePop()
+			end
+			imgui.TreePop()
+		end
+
+		if imgui.TreeNode('GL Calls') then
+			local gl_calls = tdengine.ffi.gpu_check_gl_calls()
+			imgui.extensions.Table({
+				issued = gl_calls.issued,
+				skipped = gl_calls.skipped,
+			})
+			imgui.TreePop()
+		end
+
 		imgui.extensions.Table(tdengine.gpus)
 		imgui.TreePop()
 	end
@@ -376,6 +424,25 @@ function EngineStats:engine_viewer()
 			tdengine.ffi.lf_destroy_all()
 		end
 
+		if imgui.TreeNode('Pool') then
+			if imgui.Button('Trim') then
+				tdengine.ffi.trim_particle_pool()
+			end
+
+			local pool = tdengine.ffi.check_particle_pool()
+			imgui.extensions.Table({
+				budget = string.format('%.2f MB', pool.bytes_budget / (1024 * 1024)),
+				resident = string.format('%.2f MB', pool.bytes_resident / (1024 * 1024)),
+				in_use = string.format('%.2f MB', pool.bytes_in_use / (1024 * 1024)),
+				blocks_in_use = pool.blocks_in_use,
+				blocks_cached = pool.blocks_cached,
+				allocations = pool.allocations,
+				reuses = pool.reuses,
+				failures = pool.failures,
+			})
+			imgui.TreePop()
+		end
+
 		local particle_systems = tdengine.find_entities('ParticleSystem')
 		for id, particle_system in pairs(particle_systems) do
 			if not self.particle_systems[particle_system.uuid] then
@@ -47,7 +47,7 @@ end
 function EulerianFluidSystem:update()
   if not self.handle then return end
 
-  tdengine.ffi.set_active_shader('fluid_eulerian')
+  tdengine.ffi.set_active_shader_handle(tdengine.gpus.find_handle(Shader.FluidEulerian))
   tdengine.ffi.set_draw_primitive(tdengine.enums.DrawPrimitive.Triangles)
   tdengine.ffi.set_world_space(true)
   tdengine.ffi.set_layer(10000)
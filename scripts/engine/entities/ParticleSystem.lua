@@ -14,6 +14,7 @@ ParticleSystem.editor_fields = {
   'image',
   'position_mode',
   'lifetime',
+  'capacity',
   'spawn_rate',
   'velocity_base',
   'velocity_max',
@@ -21,6 +22,7 @@ ParticleSystem.editor_fields = {
   'jitter_base_velocity',
   'jitter_max_velocity',
   'warmup',
+  'warmup_mode',
   'particle_kind',
   'particle_data',
   'gravity_source',
@@ -65,12 +67,14 @@ function ParticleSystem:init(params)
   self.opacity_interpolate_target = params.opacity_interpolate_target or 0
 
   self.lifetime = params.lifetime or 4
+  self.capacity = params.capacity or 4096
 
   self.particles = tdengine.data_types.array:new()
   self.spawn_rate = params.spawn_rate or 20
   self.spawn_accumulated = 0
   self.despawn = tdengine.data_types.array:new()
   self.warmup = params.warmup or 0
+  self.warmup_mode = tdengine.enum.load(params.warmup_mode) or tdengine.enums.ParticleWarmupMode.Simulate
   self.start_disabled = ternary(params.start_disabled, true, false)
 
   self:set_particle_kind(tdengine.enum.load(params.particle_kind) or tdengine.enums.ParticleKind.Quad,
@@ -92,6 +96,7 @@ function ParticleSystem:init(params)
   }
 
   -- FFI
+  self.descriptor = ffi.new('ParticleSystemDescriptor')
   self.handle = tdengine.ffi.make_particle_system();
   self:sync()
   if self.start_disabled then
@@ -118,7 +123,6 @@ function ParticleSystem:update()
 end
 
 function ParticleSystem:draw()
-  tdengine.ffi.update_particles(self.handle)
   if self.interpolate_emission then
     self.interpolation.emission:update()
     self.master_opacity = self.interpolation.emission:get_value()
@@ -143,44 +147,69 @@ end
 
 function ParticleSystem:sync()
   tdengine.editor.ignore_field(self, 'handle')
+  tdengine.editor.ignore_field(self, 'descriptor')
   if not self.handle then return end
 
-  tdengine.ffi.set_particle_warmup(self.handle, self.warmup)
-  tdengine.ffi.set_particle_lifetime(self.handle, self.lifetime)
-  tdengine.ffi.set_particle_max_spawn(self.handle, 32000)
-  tdengine.ffi.set_particle_spawn_rate(self.handle, self.spawn_rate)
-  tdengine.ffi.set_particle_position(self.handle, self.collider:get_xmin(), self.collider:get_ymin())
-  tdengine.ffi.set_particle_position_mode(self.handle, tdengine.ffi.ParticlePositionMode_Bottom)
-  tdengine.ffi.set_particle_area(self.handle, self.collider:get_dimension().x, self.collider:get_dimension().y)
-  tdengine.ffi.set_particle_kind(self.handle, tdengine.ffi.ParticleKind_Quad)
-  tdengine.ffi.set_particle_color(self.handle, self.color.r, self.color.g, self.color.b, self.color.a)
-  tdengine.ffi.set_particle_layer(self.handle, self.layer)
-  tdengine.ffi.set_particle_velocity_fn(self.handle, tdengine.ffi.InterpolationFn_Linear)
-  tdengine.ffi.set_particle_velocity_base(self.handle, self.velocity_base.x, self.velocity_base.y)
-  tdengine.ffi.set_particle_velocity_max(self.handle, self.velocity_max.x, self.velocity_max.y)
-  tdengine.ffi.set_particle_velocity_jitter(self.handle, self.velocity_jitter.x, self.velocity_jitter.y)
-  tdengine.ffi.set_particle_jitter_base_velocity(self.handle, self.jitter_base_velocity)
-  tdengine.ffi.set_particle_jitter_max_velocity(self.handle, self.jitter_max_velocity)
-  tdengine.ffi.set_particle_size_jitter(self.handle, self.size_jitter)
-  tdengine.ffi.set_particle_jitter_size(self.handle, self.jitter_size)
-  tdengine.ffi.set_particle_master_opacity(self.handle, self.master_opacity)
-  tdengine.ffi.set_particle_opacity_jitter(self.handle, self.opacity_jitter)
-  tdengine.ffi.set_particle_jitter_opacity(self.handle, self.jitter_opacity)
-  tdengine.ffi.set_particle_opacity_interpolation(self.handle, self.opacity_interpolate_active,
-    self.opacity_interpolate_time, self.opacity_interpolate_target)
-
-  tdengine.ffi.set_particle_gravity_source(self.handle, self.gravity_source.x, self.gravity_source.y)
-  tdengine.ffi.set_particle_gravity_intensity(self.handle, self.gravity_intensity)
-  tdengine.ffi.set_particle_gravity_enabled(self.handle, self.gravity_enabled)
-
-  tdengine.ffi.set_particle_kind(self.handle, self.particle_kind:to_number())
+  -- Fill in every parameter and hand the whole thing to C at once, rather than one FFI call per field
+  local descriptor = self.descriptor
+  descriptor.particle_kind = self.particle_kind:to_number()
   if self.particle_kind == tdengine.enums.ParticleKind.Quad then
-    tdengine.ffi.set_particle_size(self.handle, self.particle_data.size.x, self.particle_data.size.y)
+    descriptor.size.x = self.particle_data.size.x
+    descriptor.size.y = self.particle_data.size.y
   elseif self.particle_kind == tdengine.enums.ParticleKind.Circle then
-    tdengine.ffi.set_particle_radius(self.handle, self.particle_data.radius)
+    descriptor.radius = self.particle_data.radius
   elseif self.particle_kind == tdengine.enums.ParticleKind.Image then
-    tdengine.ffi.set_particle_sprite(self.handle, self.particle_data.sprite)
-    tdengine.ffi.set_particle_size(self.handle, self.particle_data.size.x, self.particle_data.size.y)
+    descriptor.sprite = self.particle_data.sprite
+    descriptor.size.x = self.particle_data.size.x
+    descriptor.size.y = self.particle_data.size.y
+  end
+
+  descriptor.color.x = self.color.r
+  descriptor.color.y = self.color.g
+  descriptor.color.z = self.color.b
+  descriptor.color.w = self.color.a
+  descriptor.position_mode = tdengine.ffi.ParticlePositionMode_Bottom
+  descriptor.position.x = self.collider:get_xmin()
+  descriptor.position.y = self.collider:get_ymin()
+  descriptor.area.x = self.collider:get_dimension().x
+  descriptor.area.y = self.collider:get_dimension().y
+  descriptor.layer = self.layer
+  descriptor.capacity = self.capacity
+  descriptor.max_spawn = 32000
+  descriptor.spawn_rate = self.spawn_rate
+  descriptor.lifetime = self.lifetime
+  descriptor.warmup_iter = self.warmup
+  descriptor.warmup_mode = self.warmup_mode:to_number()
+
+  descriptor.velocity_fn = tdengine.ffi.InterpolationFn_Linear
+  descriptor.velocity_base.x = self.velocity_base.x
+  descriptor.velocity_base.y = self.velocity_base.y
+  descriptor.velocity_max.x = self.velocity_max.x
+  descriptor.velocity_max.y = self.velocity_max.y
+  descriptor.velocity_jitter.x = self.velocity_jitter.x
+  descriptor.velocity_jitter.y = self.velocity_jitter.y
+  descriptor.jitter_base_velocity = self.jitter_base_velocity
+  descriptor.jitter_max_velocity = self.jitter_max_velocity
+  descriptor.size_jitter = self.size_jitter
+  descriptor.jitter_size = self.jitter_size
+
+  descriptor.master_opacity = self.master_opacity
+  descriptor.opacity_jitter = self.opacity_jitter
+  descriptor.jitter_opacity = self.jitter_opacity
+  descriptor.opacity_interpolate_active = self.opacity_interpolate_active
+  descriptor.opacity_interpolate_time = self.opacity_interpolate_time
+  descriptor.opacity_interpolate_target = self.opacity_interpolate_target
+
+  descriptor.gravity_source.x = self.gravity_source.x
+  descriptor.gravity_source.y = self.gravity_source.y
+  descriptor.gravity_intensity = self.gravity_intensity
+  descriptor.gravity_enabled = self.gravity_enabled
+
+  tdengine.ffi.apply_particle_descriptor(self.handle, descriptor)
+
+  local stats = tdengine.ffi.check_particle_system(self.handle)
+  if stats.out_of_budget then
+    tdengine.log(string.format('particle pool is over budget; requested = %d, capacity = %d', self.capacity, stats.capacity))
   end
 end
 
@@ -242,7 +271,9 @@ function ParticleSystem:check_stats()
   return {
     spawned = stats.spawned,
     despawned = stats.despawned,
-    alive = stats.alive
+    alive = stats.alive,
+    capacity = stats.capacity,
+    out_of_budget = stats.out_of_budget
   }
 end
 
@@ -29,6 +29,9 @@ Shader = tdengine.enum.define(
 		FluidUpdate = 17,
 		FluidEulerianInit = 18,
 		FluidEulerianUpdate = 19,
+		ParticleInstance = 20,
+		SpriteArray = 21,
+		SdfInstance = 22,
 	}
 )
 
@@ -82,6 +82,7 @@ return {
 			descriptor = {
 				max_vertices = 1024,
 				max_draw_calls = 64,
+				cull = true,
 				vertex_attributes = {
 					{
 						count = 3,
@@ -103,6 +104,7 @@ return {
 			descriptor = {
 				max_vertices = 1024,
 				max_draw_calls = 64,
+				cull = true,
 				vertex_attributes = {
 					{
 						count = 3,
@@ -379,6 +381,15 @@ return {
 				fragment_shader = 'sdf.fragment'
 			}
 		},
+		{
+			id = Shader.SdfInstance,
+			descriptor = {
+				kind = tdengine.enums.GpuShaderKind.Graphics,
+				name = 'sdf_instance',
+				vertex_shader = 'sdf_instance.vertex',
+				fragment_shader = 'sdf_instance.fragment'
+			}
+		},
 		{
 			id = Shader.SdfNormal,
 			descriptor = {
@@ -415,6 +426,15 @@ return {
 				fragment_shader = 'sprite.fragment'
 			}
 		},
+		{
+			id = Shader.SpriteArray,
+			descriptor = {
+				kind = tdengine.enums.GpuShaderKind.Graphics,
+				name = 'sprite_array',
+				vertex_shader = 'sprite_array.vertex',
+				fragment_shader = 'sprite_array.fragment'
+			}
+		},
 		{
 			id = Shader.Text,
 			descriptor = {
@@ -451,6 +471,15 @@ return {
 				fragment_shader = 'particle.fragment'
 			}
 		},
+		{
+			id = Shader.ParticleInstance,
+			descriptor = {
+				kind = tdengine.enums.GpuShaderKind.Graphics,
+				name = 'particle_instance',
+				vertex_shader = 'particle_instance.vertex',
+				fragment_shader = 'particle_instance.fragment'
+			}
+		},
 		{
 			id = Shader.Fluid,
 			descriptor = {
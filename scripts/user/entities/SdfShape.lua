@@ -21,18 +21,43 @@ function SdfShape:init(params)
 end
 
 function SdfShape:draw()
-  self:draw_to('color', 'sdf')
-  self:draw_to('scene', 'sdf')
-  self:draw_to('normals', 'sdf_normal')
+  local color = self.color:to_vec4()
+  self:draw_to('color', color)
+  self:draw_to('scene', color)
+
+  self:draw_normals()
 end
 
-function SdfShape:draw_to(render_pass, shader)
+function SdfShape:draw_to(render_pass, color)
   tdengine.gpu.bind_render_pass(render_pass)
-  tdengine.ffi.set_active_shader(shader)
   tdengine.ffi.set_world_space(true)
-	tdengine.ffi.set_draw_primitive(tdengine.enums.DrawPrimitive.Triangles);
+
+  local p = self:find_component('Collider'):get_position()
+  local s = self:find_component('Collider'):get_dimension()
+
+  if self.shape == tdengine.enums.Sdf.Box then
+    tdengine.ffi.draw_box_sdf(p.x, p.y, s.x, s.y, color, self.edge_thickness)
+  elseif self.shape == tdengine.enums.Sdf.OrientedBox then
+    local center_a = ffi.new('Vector2', p.x, p.y)
+    local center_b = ffi.new('Vector2', p.x + s.x, p.y - s.y)
+    local thickness = 8
+    tdengine.ffi.draw_oriented_box_sdf(center_a, center_b, thickness, color, self.edge_thickness)
+  elseif self.shape == tdengine.enums.Sdf.Circle then
+    local radius = math.min(s.x, s.y)
+    tdengine.ffi.draw_circle_sdf(p.x, p.y, radius, color, self.edge_thickness)
+  end
+
+  tdengine.gpu.submit_render_pass(render_pass)
+end
+
+-- The instanced SDF shader only knows how to fill a shape, so normals are still drawn one shape at a time
+function SdfShape:draw_normals()
+  tdengine.gpu.bind_render_pass('normals')
+  tdengine.ffi.set_active_shader_handle(tdengine.gpus.find_handle(Shader.SdfNormal))
+  tdengine.ffi.set_world_space(true)
+  tdengine.ffi.set_draw_primitive(tdengine.enums.DrawPrimitive.Triangles)
   tdengine.ffi.set_uniform_f32('edge_thickness', self.edge_thickness)
-	tdengine.ffi.set_uniform_enum("shape", self.shape);
+  tdengine.ffi.set_uniform_enum('shape', self.shape)
 
   local p = self:find_component('Collider'):get_position()
   local s = self:find_component('Collider'):get_dimension()
@@ -60,24 +85,18 @@ function SdfShape:draw_to(render_pass, shader)
       nil,
       1.0
     )
-
   elseif self.shape == tdengine.enums.Sdf.Circle then
     local radius = math.min(s.x, s.y)
 
-    tdengine.ffi.set_uniform_vec2("point", ffi.new('Vector2', p.x, p.y));
-    tdengine.ffi.set_uniform_f32("edge_thickness", self.edge_thickness);
-    tdengine.ffi.set_uniform_enum("shape", tdengine.enums.Sdf.Circle);
-    tdengine.ffi.set_uniform_f32("radius", radius);
-  
+    tdengine.ffi.set_uniform_vec2('point', ffi.new('Vector2', p.x, p.y))
+    tdengine.ffi.set_uniform_f32('radius', radius)
     tdengine.ffi.push_quad(
       p.x - radius, p.y + radius,
       2 * radius, 2 * radius,
       nil,
-      1.0);
-
-    local renderer = tdengine.subsystem.find('DeferredRenderer')
-    renderer:draw_circle(SdfCircle:new(p.x, p.y, radius, self.edge_thickness))
+      1.0
+    )
   end
 
-  tdengine.gpu.submit_render_pass(render_pass)
-end
\ No newline at end of file
+  tdengine.gpu.submit_render_pass('normals')
+end
@@ -353,6 +353,7 @@ bool Background::is_dirty() {
 void Background::load_one_to_gpu() {
 	auto tile = loaded_tiles[gpu_load_index++];
 	tile->texture->load_to_gpu(tile->data);
+	tile->texture->load_to_array(tile->data);
 	free(tile->data);
 
 	if (gpu_load_index == loaded_tiles.size) {
@@ -0,0 +1,382 @@
+// A standalone benchmark for the particle simulation. It builds particle.cpp on its own, with no window, GL, Lua
+// or assets; draw_particles() records into a null sink that only counts what it was given. Every scenario runs a
+// fixed number of frames at a fixed dt from fixed seeds, so two builds can be compared run for run.
+//
+// Results go to stdout as one JSON object per scenario. Build with build/linux/particle_bench.sh.
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <immintrin.h>
+#include <mutex>
+#include <random>
+#include <stdarg.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <sys/resource.h>
+
+#include "handmade/HandmadeMath.h"
+typedef HMM_Mat4 Matrix4;
+typedef HMM_Mat3 Matrix3;
+
+// utils.hpp has a PNG helper that needs stb_image to link
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+// utils.hpp keeps a pointer to the window around
+struct GLFWwindow;
+
+#include "utils/types.hpp"
+#include "utils/assert.hpp"
+#include "utils/error.hpp"
+#include "utils/macros.hpp"
+#include "utils/log.hpp"
+#include "utils/array.hpp"
+#include "utils/memory.hpp"
+#include "utils/ring_buffer.hpp"
+#include "utils/string.hpp"
+#include "utils/vector.hpp"
+#include "utils/utils.hpp"
+#include "utils/hash.hpp"
+#include "engine.hpp"
+#include "time_metrics.hpp"
+#include "interpolation.hpp"
+
+
+/////////////////////
+// NULL DRAW SINK  //
+/////////////////////
+// Just enough of draw.hpp and image.hpp for particle.cpp. Instance data is written into one scratch buffer
+// that's reused for every draw, so drawing costs what filling the instances costs and nothing else.
+double glfwGetTime() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<double>(now).count();
+}
+
+enum class DrawPrimitive : u32 {
+	Triangles,
+};
+
+enum class VertexAttributeKind : u32 {
+	Float,
+	U32,
+};
+
+struct VertexAttribute {
+	u32 count;
+	VertexAttributeKind kind;
+	u32 divisor;
+};
+
+struct GpuShader {};
+struct GpuCommandBufferBatched {};
+
+// Nothing is culled, so every particle is always written
+struct GpuCullRect {
+	bool enabled;
+
+	bool overlaps(Vector2 min, Vector2 max) { return true; }
+};
+
+struct GpuInstanceBatchDescriptor {
+	VertexAttribute* instance_attributes;
+	u32 num_instance_attributes = 0;
+	u32 max_instances = 64 * 1024;
+	u32 vertices_per_instance = 6;
+};
+struct GpuInstanceBatch {
+	u8* scratch;
+	u32 max_instances;
+};
+
+struct GpuGraphicsPipeline {
+	GpuCommandBufferBatched* command_buffer;
+};
+
+struct RenderEngine {
+	GpuGraphicsPipeline* pipeline;
+};
+RenderEngine render;
+
+struct NullDrawSink {
+	GpuShader shader;
+	GpuCommandBufferBatched command_buffer;
+	GpuGraphicsPipeline pipeline;
+	GpuInstanceBatch batch;
+
+	u64 draw_calls;
+	u64 instances;
+	u64 uniforms;
+};
+NullDrawSink null_draw_sink;
+
+struct Texture {
+	u32 handle;
+};
+
+struct Sprite {
+	char file_path [MAX_PATH_LEN];
+	hash_t hash;
+	hash_t texture;
+	Vector2* uv;
+	Vector2I size;
+};
+
+Texture bench_texture;
+Vector2 bench_uvs [6] = { { 0, 1 }, { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+Sprite bench_sprite = { "bench.png", 0, 0, bench_uvs, { 16, 16 } };
+
+Sprite* find_sprite(const char* name) {
+	return &bench_sprite;
+}
+
+Texture* find_texture(hash_t hash) {
+	return &bench_texture;
+}
+
+
+#include "particle.hpp"
+
+GpuShader* gpu_shader_find(const char* name) {
+	return &null_draw_sink.shader;
+}
+
+GpuInstanceBatch* gpu_instance_batch_create(GpuInstanceBatchDescriptor descriptor) {
+	auto& batch = null_draw_sink.batch;
+	batch.max_instances = descriptor.max_instances;
+	batch.scratch = standard_allocator.alloc<u8>(descriptor.max_instances * sizeof(ParticleInstance));
+	return &batch;
+}
+
+u8* gpu_command_buffer_alloc_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count) {
+	if (count > batch->max_instances) return nullptr;
+
+	null_draw_sink.draw_calls++;
+	null_draw_sink.instances += count;
+	return batch->scratch;
+}
+
+// Instances are never kept past the draw that wrote them, so the whole batch is always free
+u32 gpu_instance_batch_find_room(GpuInstanceBatch* batch) {
+	return batch->max_instances;
+}
+
+void gpu_command_buffer_trim_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count) {
+	null_draw_sink.instances -= count;
+}
+
+GpuCullRect gpu_command_buffer_find_cull_rect(GpuCommandBufferBatched* command_buffer) { return {}; }
+void gpu_command_buffer_count_culled(GpuCommandBufferBatched* command_buffer, u32 kept, u32 culled) {}
+
+void set_active_shader_ex(GpuShader* shader) {}
+void set_draw_primitive(DrawPrimitive primitive) {}
+void set_uniform_texture(const char* name, i32 value) { null_draw_sink.uniforms++; }
+void set_uniform_i32(const char* name, i32 value) { null_draw_sink.uniforms++; }
+
+// The log only needs these to set up its file, which the benchmark doesn't do
+char* resolve_named_path_ex(const char* name, MemoryAllocator* allocator) { return nullptr; }
+char* resolve_named_path(const char* name) { return nullptr; }
+
+Array<ParticleSystem> particle_systems;
+
+#include "particle.cpp"
+#include "time_metrics.cpp"
+#include "utils/array.cpp"
+#include "utils/log.cpp"
+#include "utils/memory.cpp"
+
+
+///////////////
+// SCENARIOS //
+///////////////
+struct BenchScenario {
+	const char* name;
+	i32 num_systems;
+	i32 num_particles;
+	ParticleKind kind;
+	bool gravity;
+	bool interpolate_opacity;
+	bool jitter;
+};
+
+struct BenchResult {
+	double ns_per_frame;
+	double ns_per_particle;
+	double ns_per_draw;
+	u64 particle_frames;
+	u64 allocations;
+	u64 bytes_allocated;
+	u64 pool_allocations;
+	u64 pool_reuses;
+	u32 pool_bytes_resident;
+	i64 peak_rss_kb;
+};
+
+struct BenchAllocations {
+	u64 count;
+	u64 bytes;
+};
+BenchAllocations bench_allocations;
+
+// Count every allocation the particle code makes through the standard allocator
+void bench_init_allocators() {
+	standard_allocator.init();
+
+	auto on_alloc = standard_allocator.on_alloc;
+	standard_allocator.on_alloc = [on_alloc](AllocatorMode mode, u32 size, void* old_memory) -> void* {
+		if (mode != AllocatorMode::Free) {
+			bench_allocations.count++;
+			bench_allocations.bytes += size;
+		}
+		return on_alloc(mode, size, old_memory);
+	};
+}
+
+i64 bench_peak_rss_kb() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+BenchResult run_scenario(BenchScenario& scenario, i32 frames) {
+	bench_allocations = BenchAllocations();
+	auto pool_before = particle_pool.stats;
+
+	// Spawn everything at once and never let anything die, so every frame updates exactly num_particles
+	// particles per system
+	ParticleSystemHandle handles [PARTICLE_SYSTEMS_SIZE];
+	for (i32 i = 0; i < scenario.num_systems; i++) {
+		handles[i] = make_particle_system();
+
+		ParticleSystemDescriptor descriptor;
+		read_particle_descriptor(handles[i], &descriptor);
+		descriptor.particle_kind = scenario.kind;
+		descriptor.size = Vector2(4.f, 4.f);
+		descriptor.radius = 2.f;
+		descriptor.sprite = "bench.png";
+		descriptor.position = Vector2(i * 10.f, 0.f);
+		descriptor.capacity = scenario.num_particles;
+		descriptor.max_spawn = scenario.num_particles;
+		descriptor.spawn_rate = 1000000.f;
+		descriptor.lifetime = 1000000.f;
+		descriptor.gravity_enabled = scenario.gravity;
+		descriptor.gravity_source = Vector2(500.f, 500.f);
+		descriptor.opacity_interpolate_active = scenario.interpolate_opacity;
+		descriptor.opacity_interpolate_time = 0.f;
+		descriptor.opacity_interpolate_target = 0.f;
+		descriptor.jitter_base_velocity = scenario.jitter;
+		descriptor.jitter_max_velocity = scenario.jitter;
+		descriptor.jitter_size = scenario.jitter;
+		descriptor.jitter_opacity = scenario.jitter;
+		descriptor.velocity_jitter = Vector2(1.f, 1.f);
+		descriptor.size_jitter = 1.f;
+		descriptor.opacity_jitter = .1f;
+		apply_particle_descriptor(handles[i], &descriptor);
+
+		auto particle_system = find_particle_system(handles[i]);
+		particle_system->warm = true;
+		while (particle_system->num_alive < scenario.num_particles) {
+			if (!particle_system->spawn_particle()) break;
+		}
+	}
+
+	null_draw_sink.draw_calls = 0;
+	null_draw_sink.instances = 0;
+
+	u64 particle_frames = 0;
+	double update_ns = 0;
+	double draw_ns = 0;
+	for (i32 frame = 0; frame < frames; frame++) {
+		auto begin = std::chrono::steady_clock::now();
+		update_all_particles();
+		auto updated = std::chrono::steady_clock::now();
+		for (i32 i = 0; i < scenario.num_systems; i++) {
+			draw_particles(handles[i]);
+		}
+		auto drawn = std::chrono::steady_clock::now();
+
+		update_ns += std::chrono::duration<double, std::nano>(updated - begin).count();
+		draw_ns += std::chrono::duration<double, std::nano>(drawn - updated).count();
+
+		for (i32 i = 0; i < scenario.num_systems; i++) {
+			particle_frames += find_particle_system(handles[i])->num_alive;
+		}
+	}
+
+	BenchResult result;
+	result.ns_per_frame = (update_ns + draw_ns) / frames;
+	result.ns_per_particle = particle_frames ? update_ns / particle_frames : 0;
+	result.ns_per_draw = particle_frames ? draw_ns / particle_frames : 0;
+	result.particle_frames = particle_frames;
+	result.allocations = bench_allocations.count;
+	result.bytes_allocated = bench_allocations.bytes;
+	result.pool_allocations = particle_pool.stats.allocations - pool_before.allocations;
+	result.pool_reuses = particle_pool.stats.reuses - pool_before.reuses;
+	result.pool_bytes_resident = particle_pool.stats.bytes_resident;
+	result.peak_rss_kb = bench_peak_rss_kb();
+
+	for (i32 i = 0; i < scenario.num_systems; i++) {
+		free_particle_system(handles[i]);
+	}
+
+	return result;
+}
+
+void print_result(BenchScenario& scenario, BenchResult& result) {
+	const char* kinds [] = { "quad", "circle", "image", "invalid" };
+	printf(
+		"{\"scenario\": \"%s\", \"systems\": %d, \"particles\": %d, \"kind\": \"%s\", \"gravity\": %s, \"interpolate_opacity\": %s, \"jitter\": %s, "
+		"\"ns_per_frame\": %.1f, \"ns_per_particle\": %.3f, \"ns_per_particle_draw\": %.3f, \"particle_frames\": %llu, "
+		"\"allocations\": %llu, \"bytes_allocated\": %llu, \"pool_allocations\": %llu, \"pool_reuses\": %llu, \"pool_bytes_resident\": %u, \"peak_rss_kb\": %lld}\n",
+		scenario.name, scenario.num_systems, scenario.num_particles, kinds[static_cast<i32>(scenario.kind)],
+		scenario.gravity ? "true" : "false", scenario.interpolate_opacity ? "true" : "false", scenario.jitter ? "true" : "false",
+		result.ns_per_frame, result.ns_per_particle, result.ns_per_draw, (unsigned long long)result.particle_frames,
+		(unsigned long long)result.allocations, (unsigned long long)result.bytes_allocated,
+		(unsigned long long)result.pool_allocations, (unsigned long long)result.pool_reuses, result.pool_bytes_resident,
+		(long long)result.peak_rss_kb);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+	// An optional frame count, so a quick run and a careful run use the same scenarios
+	i32 frames = argc > 1 ? atoi(argv[1]) : 600;
+
+	bench_init_allocators();
+	engine.dt = 1.f / 60.f;
+	arr_init(&particle_systems, PARTICLE_SYSTEMS_SIZE);
+	init_particles();
+
+	render.pipeline = &null_draw_sink.pipeline;
+	render.pipeline->command_buffer = &null_draw_sink.command_buffer;
+
+	BenchScenario scenarios [] = {
+		{ "baseline",            1,  4096, ParticleKind::Quad,   false, false, false },
+		{ "gravity",             1,  4096, ParticleKind::Quad,   true,  false, false },
+		{ "interpolate_opacity", 1,  4096, ParticleKind::Quad,   false, true,  false },
+		{ "jitter",              1,  4096, ParticleKind::Quad,   false, false, true  },
+		{ "circle",              1,  4096, ParticleKind::Circle, false, false, false },
+		{ "image",               1,  4096, ParticleKind::Image,  false, false, false },
+		{ "many_small",          64, 64,   ParticleKind::Quad,   false, false, false },
+		{ "many_large",          16, 4096, ParticleKind::Quad,   false, true,  false },
+		{ "many_large_gravity",  16, 4096, ParticleKind::Quad,   true,  true,  true  },
+	};
+
+	for (auto& scenario : scenarios) {
+		auto result = run_scenario(scenario, frames);
+		print_result(scenario, result);
+	}
+
+	return 0;
+}
@@ -19,8 +19,7 @@ Array<TextureAtlas> atlas_infos;
 Array<SoundInfo> sound_infos;
 #define ACTIVE_SOUND_SIZE 64
 Array<ActiveSound> active_sounds;
-#define PARTICLE_SYSTEMS_SIZE 64
-Array<ParticleSystem> particle_systems;
+Array<ParticleSystem> particle_systems; // PARTICLE_SYSTEMS_SIZE is in particle.hpp
 
 
 void init_buffers() { 
@@ -1,20 +1,30 @@
 //////////////////////
 // DEFAULT RENDERER //
 //////////////////////
-Vertex* push_vertex(float px, float py, Vector4 color) {
-	return push_vertex(px, py, Vector2(), color);
+void push_vertex(float px, float py, Vector4 color) {
+	push_vertex(px, py, Vector2(), color);
 }
 
-Vertex* push_vertex(float px, float py, Vector2 uv, Vector4 color) {
+void push_vertex(float px, float py, Vector2 uv, Vector4 color) {
 	assert(render.pipeline);
+	auto command_buffer = render.pipeline->command_buffer;
 
-	auto vertex = (Vertex*)gpu_command_buffer_alloc_vertex_data(render.pipeline->command_buffer, 1);
+	auto data = gpu_command_buffer_alloc_vertex_data(command_buffer, 1);
+	if (command_buffer->texture_arrays) {
+		auto vertex_size = command_buffer->vertices.vertex_size;
+		*reinterpret_cast<u32*>(data + vertex_size - sizeof(u32)) = 0;
+	}
+
+	if (command_buffer->packed_vertices) {
+		reinterpret_cast<PackedVertex*>(data)->pack(px, py, uv, color);
+		return;
+	}
+
+	auto vertex = reinterpret_cast<Vertex*>(data);
 	vertex->position.x = px;
 	vertex->position.y = py;
 	vertex->uv = uv;
 	vertex->color = color;
-
-	return vertex;
 }
 
 void push_quad(float px, float py, float dx, float dy, Vector2* uv, float opacity) {
@@ -25,26 +35,74 @@ void push_quad(float px, float py, float dx, float dy, Vector2* uv, Vector4 colo
 	static Vector2 default_uvs [6] = fm_quad(1, 0, 0, 1);
 	if (!uv) uv = default_uvs;
 
+	Vector2 vx [6] = fm_quad(py, py - dy, px, px + dx);
+	push_quad_ex(vx, uv, color);
+}
+
+// Positions and UVs are six corners laid out like fm_quad(); indexed quads only need the four distinct ones
+void push_quad_ex(Vector2* positions, Vector2* uvs, Vector4 color) {
+	push_quad_ex(positions, uvs, color, 0);
+}
+
+void push_quad_ex(Vector2* positions, Vector2* uvs, Vector4 color, u32 layer) {
 	assert(render.pipeline);
+	auto command_buffer = render.pipeline->command_buffer;
+
+	// The texture layer is appended to the vertex, so step by the buffer's vertex size rather than the struct's
+	auto vertex_size = command_buffer->vertices.vertex_size;
+	auto write_vertex = [&](u8* data, u32 index, u32 corner) {
+		data += index * vertex_size;
+		if (command_buffer->texture_arrays) {
+			*reinterpret_cast<u32*>(data + vertex_size - sizeof(u32)) = layer;
+		}
 
-	Vector2 vx [6] = fm_quad(py, py - dy, px, px + dx);
-	for (i32 i = 0; i < 6; i++) {
-		auto vertex = (Vertex*)gpu_command_buffer_alloc_vertex_data(render.pipeline->command_buffer, 1);
-		vertex->position.x = vx[i].x;
-		vertex->position.y = vx[i].y;
+		if (command_buffer->packed_vertices) {
+			reinterpret_cast<PackedVertex*>(data)->pack(positions[corner].x, positions[corner].y, uvs[corner], color);
+			return;
+		}
+
+		auto vertex = reinterpret_cast<Vertex*>(data);
+		vertex->position.x = positions[corner].x;
+		vertex->position.y = positions[corner].y;
 		vertex->color = color;
-		vertex->uv = uv[i];
+		vertex->uv = uvs[corner];
+	};
+
+	if (command_buffer->indexed_quads) {
+		static u32 corners [GpuQuadIndexBuffer::vertices_per_quad] = { 0, 1, 2, 5 };
+
+		auto data = gpu_command_buffer_alloc_quad_data(command_buffer, 1);
+		for (u32 i = 0; i < GpuQuadIndexBuffer::vertices_per_quad; i++) {
+			write_vertex(data, i, corners[i]);
+		}
+	}
+	else {
+		auto data = gpu_command_buffer_alloc_vertex_data(command_buffer, 6);
+		for (u32 i = 0; i < 6; i++) {
+			write_vertex(data, i, i);
+		}
 	}
 }
 
+void PackedVertex::pack(float px, float py, Vector2 uv, Vector4 color) {
+	auto pack_u16 = [](float value) {
+		return (u16)(clamp(value, 0.f, 1.f) * 65535.f + .5f);
+	};
+
+	this->position.x = px;
+	this->position.y = py;
+	this->color = pack_rgba8(color);
+	this->uv[0] = pack_u16(uv.x);
+	this->uv[1] = pack_u16(uv.y);
+}
+
 void draw_quad_ex(float px, float py, float sx, float sy, Vector4 color) {
-	set_active_shader("solid");
+	if (cull_aabb(Vector2(px, py - sy), Vector2(px + sx, py))) return;
+
+	set_active_shader_handle(render.builtin_shaders.solid);
 	set_draw_primitive(DrawPrimitive::Triangles);
 		
-	Vector2 vxs [6] = fm_quad(py, py - sy, px, px + sx);
-	for (int32 i = 0; i < 6; i++) {
-		push_vertex(vxs[i].x, vxs[i].y, color);
-	}
+	push_quad(px, py, sx, sy, nullptr, color);
 }
 
 void draw_quad(Vector2 position, Vector2 size, Vector4 color) {
@@ -52,106 +110,194 @@ void draw_quad(Vector2 position, Vector2 size, Vector4 color) {
 }
 
 void draw_circle(float32 px, float32 py, float32 radius, Vector4 color) {
-	set_active_shader("solid");
+	// Big circles are one SDF quad, unless the command buffer has no room left for another instance. Shapes are
+	// culled when they're pushed, so only check the circle once it's known to be tesselated.
+	if (circle_renderer.sdf_radius > 0 && radius > circle_renderer.sdf_radius) {
+		if (push_sdf_instance(Sdf::Circle, Vector2(px, py), Vector2(radius, radius), 0.f, color, 1.f)) return;
+	}
+
+	if (cull_aabb(Vector2(px - radius, py - radius), Vector2(px + radius, py + radius))) return;
+
+	set_active_shader_handle(render.builtin_shaders.solid);
 	set_draw_primitive(DrawPrimitive::Triangles);
 	// GL_TRIANGLE_FAN means we can't batch draw calls; GL_TRIANGLE_STRIP would force me to figure out another algorithm
 	// for tesselating the circle, and I'm lazy, but it lets you batch with degenerate triangles.
-	
-	float32 x = 0;
-	float32 y = 0;
-	uint32 segments = 5 * sqrt(radius);
-	float32 theta = 2 * 3.14159 / segments;
-	float32 c = cos(theta);
-	float32 s = sin(theta);
-	
-	y = radius;
-	for (uint32 i = 0; i < segments; i++) {
-		push_vertex(px, py, color);
-		push_vertex(px + x, py + y, color);
 
-		auto tx = x;
-		auto ty = y;
-		x = c * tx - s * ty;
-		y = c * ty + s * tx;
-		push_vertex(px + x, py + y, color);
+	auto segments = circle_renderer.find_segments(radius);
+	auto offset = circle_renderer.find_offset(segments);
+	auto unit_x = circle_renderer.unit_x + offset;
+	auto unit_y = circle_renderer.unit_y + offset;
+
+	float32 xs [CircleRenderer::max_segments + 1];
+	float32 ys [CircleRenderer::max_segments + 1];
+	u32 num_points = segments + 1;
+	u32 index = 0;
+
+#if FM_SIMD
+	auto px4 = _mm_set1_ps(px);
+	auto py4 = _mm_set1_ps(py);
+	auto radius4 = _mm_set1_ps(radius);
+	for (; index + 4 <= num_points; index += 4) {
+		_mm_storeu_ps(xs + index, _mm_add_ps(px4, _mm_mul_ps(radius4, _mm_loadu_ps(unit_x + index))));
+		_mm_storeu_ps(ys + index, _mm_add_ps(py4, _mm_mul_ps(radius4, _mm_loadu_ps(unit_y + index))));
+	}
+#endif
+
+	for (; index < num_points; index++) {
+		xs[index] = px + radius * unit_x[index];
+		ys[index] = py + radius * unit_y[index];
+	}
+
+	// Every vertex is the same apart from its position, so build one and copy it. Both vertex layouts start with
+	// the position, and a texture array layer stays zero.
+	auto command_buffer = render.pipeline->command_buffer;
+	auto vertex_size = command_buffer->vertices.vertex_size;
+	assert(vertex_size <= sizeof(Vertex) + sizeof(u32));
+
+	u8 center [sizeof(Vertex) + sizeof(u32)] = {};
+	if (command_buffer->packed_vertices) {
+		reinterpret_cast<PackedVertex*>(center)->pack(px, py, Vector2(), color);
+	}
+	else {
+		auto vertex = reinterpret_cast<Vertex*>(center);
+		vertex->position.x = px;
+		vertex->position.y = py;
+		vertex->color = color;
+	}
+
+	auto data = gpu_command_buffer_alloc_vertex_data(command_buffer, 3 * segments);
+	auto write_vertex = [&](float32 x, float32 y) {
+		copy_memory(center, data, vertex_size);
+		auto position = reinterpret_cast<float32*>(data);
+		position[0] = x;
+		position[1] = y;
+		data += vertex_size;
+	};
+
+	for (u32 i = 0; i < segments; i++) {
+		write_vertex(px, py);
+		write_vertex(xs[i], ys[i]);
+		write_vertex(xs[i + 1], ys[i + 1]);
 	}
 }
 
-void draw_circle_sdf(float32 px, float32 py, float32 radius, Vector4 color, float edge_thickness) {
-	gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
+void set_circle_sdf_radius(float32 radius) {
+	circle_renderer.sdf_radius = radius;
+}
 
-	set_active_shader("sdf");
-	set_draw_primitive(DrawPrimitive::Triangles);
-	
-	set_uniform_vec2("point", { px, py });
-	set_uniform_f32("edge_thickness", edge_thickness);
-	set_uniform_i32("shape", static_cast<i32>(Sdf::Circle));
-	set_uniform_f32("radius", radius);
-	
-	push_quad(px - radius, py + radius, 2 * radius, 2 * radius, nullptr, color);
+// Returns whether a primitive with these bounds can't be seen, in which case it should be skipped before any of its
+// vertices are generated
+bool cull_aabb(Vector2 min, Vector2 max) {
+	auto command_buffer = render.pipeline->command_buffer;
+	if (!command_buffer->cull) return false;
+
+	auto cull = gpu_command_buffer_find_cull_rect(command_buffer);
+	if (!cull.enabled) return false;
+
+	bool visible = cull.overlaps(min, max);
+	gpu_command_buffer_count_culled(command_buffer, visible ? 1 : 0, visible ? 0 : 1);
+	return !visible;
+}
+
+void draw_circle_sdf(float32 px, float32 py, float32 radius, Vector4 color, float edge_thickness) {
+	draw_sdf(Sdf::Circle, Vector2(px, py), Vector2(radius, radius), 0.f, color, edge_thickness);
 }
 
 void draw_ring_sdf(float32 px, float32 py, float inner_radius, float radius, Vector4 color, float edge_thickness) {
-	gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
+	draw_sdf(Sdf::Ring, Vector2(px, py), Vector2(radius, inner_radius), 0.f, color, edge_thickness);
+}
 
-	set_active_shader("sdf");
-	set_draw_primitive(DrawPrimitive::Triangles);
-	
-	set_uniform_vec2("point", { px, py });
-	set_uniform_f32("edge_thickness", edge_thickness);
-	set_uniform_i32("shape", static_cast<i32>(Sdf::Ring));
-	set_uniform_f32("radius", radius);
-	set_uniform_f32("inner_radius", inner_radius);
-	
-	push_quad(px - radius, py + radius, 2 * radius, 2 * radius, nullptr, color);
+// Same placement as draw_quad(); (px, py) is the top left
+void draw_box_sdf(float32 px, float32 py, float32 dx, float32 dy, Vector4 color, float edge_thickness) {
+	auto half = Vector2(dx / 2, dy / 2);
+	draw_sdf(Sdf::Box, Vector2(px + half.x, py - half.y), half, 0.f, color, edge_thickness);
+}
+
+void draw_oriented_box_sdf(Vector2 start, Vector2 end, float32 thickness, Vector4 color, float edge_thickness) {
+	auto delta = v2_subtract(end, start);
+	auto center = v2_add(start, v2_scale(delta, .5f));
+	auto half = Vector2(v2_length(delta) / 2, thickness / 2);
+	draw_sdf(Sdf::OrientedBox, center, half, atan2(delta.y, delta.x), color, edge_thickness);
+}
+
+// Shapes are instanced whenever possible. If there's no instance shader or no room left in the command buffer's
+// batch, they're drawn the old way instead of being dropped.
+void draw_sdf(Sdf shape, Vector2 position, Vector2 size, float rotation, Vector4 color, float edge_thickness) {
+	if (push_sdf_instance(shape, position, size, rotation, color, edge_thickness)) return;
+	push_sdf_quad(shape, position, size, rotation, color, edge_thickness);
 }
 
 	
 void draw_image(const char* name, float px, float py) {
 	auto sprite = find_sprite(name);
 	auto texture = find_texture(sprite->texture);
-	draw_image_pro(texture->handle, px, py, sprite->size.x, sprite->size.y, sprite->uv, 1.f);
+	draw_image_pro(texture, px, py, sprite->size.x, sprite->size.y, sprite->uv, 1.f);
 }
 
 void draw_image_size(const char* name, float px, float py, float dx, float dy) {
 	auto sprite = find_sprite(name);
 	auto texture = find_texture(sprite->texture);
-	draw_image_pro(texture->handle, px, py, dx, dy, sprite->uv, 1.f);
+	draw_image_pro(texture, px, py, dx, dy, sprite->uv, 1.f);
 }
 
 void draw_image_ex(const char* name, float px, float py, float dx, float dy, float opacity) {
 	auto sprite = find_sprite(name);
 	auto texture = find_texture(sprite->texture);
-	draw_image_pro(texture->handle, px, py, dx, dy, sprite->uv, opacity);
+	draw_image_pro(texture, px, py, dx, dy, sprite->uv, opacity);
 }
 
 
 void draw_image(Sprite* sprite, float px, float py) {
 	if (!sprite) return;
 	auto texture = find_texture(sprite->texture);
-	draw_image_pro(texture->handle, px, py, sprite->size.x, sprite->size.y, sprite->uv, 1.f);
+	draw_image_pro(texture, px, py, sprite->size.x, sprite->size.y, sprite->uv, 1.f);
 }
 
 void draw_image(Sprite* sprite, float px, float py, float dx, float dy) {
 	if (!sprite) return;
 	auto texture = find_texture(sprite->texture);
-	draw_image_pro(texture->handle, px, py, dx, dy, sprite->uv, 1.f);
+	draw_image_pro(texture, px, py, dx, dy, sprite->uv, 1.f);
 }
 
 void draw_image(Sprite* sprite, float px, float py, float dx, float dy, float opacity) {
 	if (!sprite) return;
 	auto texture = find_texture(sprite->texture);
-	draw_image_pro(texture->handle, px, py, dx, dy, sprite->uv, opacity);
+	draw_image_pro(texture, px, py, dx, dy, sprite->uv, opacity);
 }
 
 void draw_image_pro(u32 texture, float px, float py, float dx, float dy, Vector2* uv, float opacity) {
-	set_active_shader("sprite");
+	if (cull_aabb(Vector2(px, py - dy), Vector2(px + dx, py))) return;
+
+	set_active_shader_handle(render.builtin_shaders.sprite);
 	set_draw_primitive(DrawPrimitive::Triangles);
 	set_uniform_texture("sampler", texture);
 
 	push_quad(px, py, dx, dy, uv, opacity);
 }
 
+void draw_image_pro(Texture* texture, float px, float py, float dx, float dy, Vector2* uv, float opacity) {
+	if (!texture) return;
+
+	// Sampling from the texture array means only a real state change splits the batch, not the texture
+	auto command_buffer = render.pipeline->command_buffer;
+	if (!texture->array || !command_buffer->texture_arrays) {
+		draw_image_pro(texture->handle, px, py, dx, dy, uv, opacity);
+		return;
+	}
+
+	if (cull_aabb(Vector2(px, py - dy), Vector2(px + dx, py))) return;
+
+	set_active_shader_handle(render.builtin_shaders.sprite_array);
+	set_draw_primitive(DrawPrimitive::Triangles);
+	set_uniform_texture_array("sampler", texture->array->handle);
+
+	auto color = colors::white;
+	color.a = opacity;
+
+	Vector2 vx [6] = fm_quad(py, py - dy, px, px + dx);
+	push_quad_ex(vx, uv, color, texture->layer);
+}
+
 
 void draw_text_ex(const char* text, float px, float py, Vector4 color, const char* font, float wrap, bool precise) {
 	auto prepared_text = prepare_text_ex(text, px, py, font, wrap, color, precise);
@@ -167,7 +313,7 @@ void draw_prepared_text(PreparedText* prepared_text) {
 	if (!prepared_text) return;
 	if (prepared_text->is_empty()) return;
 	
-	set_active_shader("text");
+	set_active_shader_handle(render.builtin_shaders.text);
 	set_uniform_texture("sampler", prepared_text->font->texture);
 	set_draw_primitive(DrawPrimitive::Triangles);
 
@@ -199,13 +345,12 @@ void draw_prepared_text(PreparedText* prepared_text) {
 			// because a glyph's texture is pixel perfect, and depending on which way the rounding goes it could
 			// omit that last row or column of pixels. I can't quite math it out exactly, but it seems totally
 			// reasonable that that's the case. To get around this, I just round to the nearest integer.
+			Vector2 positions [6];
 			for (i32 i = 0; i < 6; i++) {
-				auto vertex = push_vertex(
-					floorf(point.x + glyph->verts[i].x), floorf(point.y + glyph->verts[i].y), 
-					glyph->uv[i], 
-					prepared_text->color
-				);
+				positions[i].x = floorf(point.x + glyph->verts[i].x);
+				positions[i].y = floorf(point.y + glyph->verts[i].y);
 			}
+			push_quad_ex(positions, glyph->uv, prepared_text->color);
 
 			// Advance one character
 			point.x += glyph->advance.x;
@@ -219,7 +364,12 @@ void draw_prepared_text(PreparedText* prepared_text) {
 }
 
 void draw_line(Vector2 start, Vector2 end, float thickness, Vector4 color) {
-	set_active_shader("solid");
+	auto extent = thickness / 2;
+	auto min = Vector2(std::min(start.x, end.x) - extent, std::min(start.y, end.y) - extent);
+	auto max = Vector2(std::max(start.x, end.x) + extent, std::max(start.y, end.y) + extent);
+	if (cull_aabb(min, max)) return;
+
+	set_active_shader_handle(render.builtin_shaders.solid);
 	set_draw_primitive(DrawPrimitive::Triangles);
 
 	auto line = v2_subtract(end, start);
@@ -252,21 +402,20 @@ void set_draw_primitive(DrawPrimitive primitive) {
 
 void set_blend_enabled(bool enabled) {
 	auto draw_call = gpu_command_buffer_find_draw_call(render.pipeline->command_buffer);
-	if (draw_call->state.blend_enabled != enabled) return;
+	if (draw_call->state.key.blend_enabled != enabled) return;
 	
 	draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.blend_enabled = enabled;
+	draw_call->state.key.blend_enabled = enabled;
 }
 
 void set_blend_mode(i32 source, i32 dest) {
-	auto blend_source = convert_blend_mode(static_cast<BlendMode>(source));
-	auto blend_dest = convert_blend_mode(static_cast<BlendMode>(dest));
+	auto blend_source = static_cast<BlendMode>(source);
+	auto blend_dest = static_cast<BlendMode>(dest);
 	auto draw_call = gpu_command_buffer_find_draw_call(render.pipeline->command_buffer);
-	if ((draw_call->state.blend_source == blend_source) && (draw_call->state.blend_dest == blend_dest)) return;
+	if ((draw_call->state.key.blend_source == source) && (draw_call->state.key.blend_dest == dest)) return;
 	
 	draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.blend_source = blend_source;
-	draw_call->state.blend_dest = blend_dest;
+	draw_call->state.set_blend(blend_source, blend_dest);
 }
 
 
@@ -276,14 +425,17 @@ void set_active_shader(const char* name) {
 }
 
 void set_active_shader_ex(GpuShader* shader) {
-	if (!shader) return;
+	set_active_shader_handle(gpu_shader_get_handle(shader));
+}
+
+void set_active_shader_handle(GpuShaderHandle handle) {
+	if (!handle) return;
 
 	auto draw_call = gpu_command_buffer_find_draw_call(render.pipeline->command_buffer);
-	if (draw_call->state.shader == shader) return;
+	if (draw_call->state.key.shader == handle) return;
 		
 	draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.shader = shader;
-
+	draw_call->state.key.shader = handle;
 }
 
 void set_orthographic_projection(float left, float right, float bottom, float top, float _near, float _far) {
@@ -292,19 +444,23 @@ void set_orthographic_projection(float left, float right, float bottom, float to
 
 void begin_scissor(float px, float py, float dx, float dy) {
 	auto draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.scissor = true;
+	draw_call->state.key.scissor = true;
 	draw_call->state.scissor_region.position = Vector2(px, py);
 	draw_call->state.scissor_region.dimension = Vector2(dx, dy);
 }
 
 void end_scissor() {
 	auto draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.scissor = false;
+	draw_call->state.key.scissor = false;
 }
 
 void set_layer(i32 layer) {
-	auto draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.layer = layer;
+	auto command_buffer = render.pipeline->command_buffer;
+	auto state = gpu_command_buffer_find_draw_call(command_buffer)->state;
+	if (state.get_layer() == layer) return;
+
+	state.set_layer(layer);
+	gpu_command_buffer_switch_bucket(command_buffer, &state);
 }
 
 void set_camera(float px, float py) {
@@ -312,21 +468,25 @@ void set_camera(float px, float py) {
 }
 
 void set_uniform(Uniform& uniform) {
-	auto draw_call = gpu_command_buffer_find_draw_call(render.pipeline->command_buffer);
-	bool had_uniform = draw_call->state.has_uniform(uniform.name);
-	auto previous_uniform = draw_call->state.find_uniform(uniform.name);
+	auto command_buffer = render.pipeline->command_buffer;
+	auto draw_call = gpu_command_buffer_find_draw_call(command_buffer);
+	auto previous_uniform = gpu_command_buffer_find_uniform(command_buffer, draw_call, uniform.id);
+	bool had_uniform = previous_uniform != nullptr;
 	bool uniform_changed = (previous_uniform) && !are_uniforms_equal(uniform, *previous_uniform);
 
 	// CASE 1: The uniform was already set to a different value, so we need a new draw call
 	if (had_uniform && uniform_changed) {
-		draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-		draw_call->state.add_uniform(uniform);
+		draw_call = gpu_command_buffer_flush_draw_call(command_buffer);
+		gpu_command_buffer_add_uniform(command_buffer, draw_call, uniform);
 		return;
 	}
-	// CASE 2: The uniform was never set, so we don't need a new draw call, but we DO need to add the uniform
+	// CASE 2: The uniform was never set, so we don't need a new draw call, but we DO need to add the uniform. A draw
+	// call that was picked back up by switching layers isn't at the end of the uniform arena, though.
 	else if (!had_uniform) {
-		draw_call = gpu_command_buffer_find_draw_call(render.pipeline->command_buffer);
-		draw_call->state.add_uniform(uniform);
+		if (draw_call->uniform_offset + draw_call->num_uniforms != command_buffer->uniforms.size) {
+			draw_call = gpu_command_buffer_flush_draw_call(command_buffer);
+		}
+		gpu_command_buffer_add_uniform(command_buffer, draw_call, uniform);
 		return;
 	}
 	// CASE 3: The uniform was already set, but to the same thing, so do nothing.
@@ -374,11 +534,28 @@ void set_uniform_texture(const char* name, i32 value) {
 	set_uniform(uniform);
 }
 
+void set_uniform_texture_array(const char* name, i32 value) {
+	auto uniform = Uniform(name);
+	uniform.kind = UniformKind::TextureArray;
+	uniform.texture = value;
+	set_uniform(uniform);
+}
+
 
 ////////////////////////////////////
 // IMMEDIATE OPENGL CONFIGURATION //
 ////////////////////////////////////
 i32 find_uniform_index(const char* name) {
+	return find_uniform_index_ex(hash_label(name), name);
+}
+
+i32 find_uniform_index_ex(UniformId id, const char* name) {
+	if (render.shader) return render.shader->find_uniform_location(id, name);
+
+	// Without a shader there's no cache, so the driver needs the name; an ID that was never interned has none
+	if (!name) name = find_uniform_name(id);
+	if (!name) return -1;
+
 	i32 program = 0;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
 	return glGetUniformLocation(program, name);
@@ -387,76 +564,95 @@ i32 find_uniform_index(const char* name) {
 void set_shader_immediate_ex(GpuShader* shader) {
 	if (!shader) return;
 	
-	glUseProgram(shader->program);
-	set_uniform_immediate_f32("master_time", engine.elapsed_time);
-	set_uniform_immediate_vec2("camera", render.camera);
+	render.gl_cache.use_program(shader->program);
+	render.shader = shader;
 }
 
 void set_shader_immediate(const char* name) {
 	auto shader = gpu_shader_find(name);
 	set_shader_immediate_ex(shader);
+	gpu_sync_frame_globals();
 }
 
 void set_uniform_immediate(const Uniform& uniform) {
+	// Skip the upload if the bound program already has this value. The uniform already knows its id, so there's
+	// no need to hash the name again.
+	i32 index = -1;
+	auto slot = render.shader ? render.shader->find_uniform_slot(uniform.id) : -1;
+	if (slot >= 0) {
+		auto& uploaded = render.shader->uniform_values[slot];
+		if (are_uniforms_equal(uploaded, uniform)) {
+			render.gl_cache.skip();
+			return;
+		}
+
+		uploaded = uniform;
+		index = render.shader->uniform_locations[slot].location;
+	}
+	else {
+		index = find_uniform_index_ex(uniform.id, nullptr);
+	}
+
+	// Uniforms the program doesn't use don't need to reach the driver either
+	if (index < 0) {
+		render.gl_cache.skip();
+		return;
+	}
+
+	render.gl_cache.issue();
+
 	if (uniform.kind == UniformKind::Matrix4) {
-		set_uniform_immediate_mat4(uniform.name, uniform.mat4);
+		glUniformMatrix4fv(index, 1, GL_FALSE, (const float*)&uniform.mat4);
 	}
 	else if (uniform.kind == UniformKind::Matrix3) {
-		set_uniform_immediate_mat3(uniform.name, uniform.mat3);
+		glUniformMatrix3fv(index, 1, GL_FALSE, (const float*)&uniform.mat3);
 	}
 	else if (uniform.kind == UniformKind::Vector4) {
-		set_uniform_immediate_vec4(uniform.name, uniform.vec4);
+		glUniform4f(index, uniform.vec4.X, uniform.vec4.Y, uniform.vec4.Z, uniform.vec4.W);
 	}
 	else if (uniform.kind == UniformKind::Vector3) {
-		set_uniform_immediate_vec3(uniform.name, uniform.vec3);
+		glUniform3f(index, uniform.vec3.X, uniform.vec3.Y, uniform.vec3.Z);
 	}
 	else if (uniform.kind == UniformKind::Vector2) {
-		set_uniform_immediate_vec2(uniform.name, uniform.vec2);
+		glUniform2f(index, uniform.vec2.x, uniform.vec2.y);
 	}
 	else if (uniform.kind == UniformKind::I32) { 
-		set_uniform_immediate_i32(uniform.name, uniform.as_i32);
+		glUniform1i(index, uniform.as_i32);
 	}
 	else if (uniform.kind == UniformKind::F32) {
-		set_uniform_immediate_f32(uniform.name, uniform.f32);
+		glUniform1f(index, uniform.f32);
 	}
-	else if (uniform.kind == UniformKind::Texture) {
-		set_uniform_immediate_i32(uniform.name, uniform.texture);
+	else if (uniform.kind == UniformKind::Texture || uniform.kind == UniformKind::TextureArray) {
+		glUniform1i(index, uniform.texture);
 	}
 }
 
 void set_uniform_immediate_vec4(const char* name, HMM_Vec4 vec) {
-	i32 index = find_uniform_index(name);
-	glUniform4f(index, vec.X, vec.Y, vec.Z, vec.W);
+	set_uniform_immediate(Uniform(name, vec));
 }
 
 void set_uniform_immediate_vec3(const char* name, HMM_Vec3 vec) {
-	i32 index = find_uniform_index(name);
-	glUniform3f(index, vec.X, vec.Y, vec.Z);
+	set_uniform_immediate(Uniform(name, vec));
 }
 
 void set_uniform_immediate_vec2(const char* name, Vector2 vec) {
-	i32 index = find_uniform_index(name);
-	glUniform2f(index, vec.x, vec.y);
+	set_uniform_immediate(Uniform(name, vec));
 }
 
 void set_uniform_immediate_mat3(const char* name, HMM_Mat3 matrix) {
-	i32 index = find_uniform_index(name);
-	glUniformMatrix3fv(index, 1, GL_FALSE, (const float*)&matrix);
+	set_uniform_immediate(Uniform(name, matrix));
 }
 
 void set_uniform_immediate_mat4(const char* name, HMM_Mat4 matrix) {
-	i32 index = find_uniform_index(name);
-	glUniformMatrix4fv(index, 1, GL_FALSE, (const float*)&matrix);
+	set_uniform_immediate(Uniform(name, matrix));
 }
 
 void set_uniform_immediate_i32(const char* name, i32 val) {
-	i32 index = find_uniform_index(name);
-	glUniform1i(index, val);
+	set_uniform_immediate(Uniform(name, val));
 }
 
 void set_uniform_immediate_f32(const char* name, float val) {
-	i32 index = find_uniform_index(name);
-	glUniform1f(index, val);
+	set_uniform_immediate(Uniform(name, val));
 }
 
 void set_uniform_immediate_texture(const char* name, i32 val) {
@@ -465,10 +661,10 @@ void set_uniform_immediate_texture(const char* name, i32 val) {
 
 void set_world_space(bool world_space) {
 	auto draw_call = gpu_command_buffer_find_draw_call(render.pipeline->command_buffer);
-	if (draw_call->state.world_space == world_space) return;
+	if (draw_call->state.key.world_space == world_space) return;
 	
 	draw_call = gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
-	draw_call->state.world_space = world_space;
+	draw_call->state.key.world_space = world_space;
 }
 
 void set_gl_name(u32 kind, u32 handle, u32 name_len, const char* name) {
@@ -652,6 +848,7 @@ u8* vertex_buffer_push(VertexBuffer* buffer, void* data, u32 count) {
 
 u8* vertex_buffer_reserve(VertexBuffer* buffer, u32 count) {
 	assert(buffer);
+	assert(buffer->size + count <= buffer->capacity);
 	
 	auto vertex = vertex_buffer_at(buffer, buffer->size);
 	buffer->size += count;
@@ -671,6 +868,100 @@ u32 vertex_buffer_byte_size(VertexBuffer* buffer) {
 }
 
 
+////////////////////
+// VERTEX STORAGE //
+////////////////////
+void GpuVertexStorage::init(u32 max_vertices, u32 vertices_per_chunk, u32 vertex_size) {
+	this->vertices_per_chunk = std::min(vertices_per_chunk, max_vertices);
+	this->vertex_size = vertex_size;
+	this->capacity = max_vertices;
+	this->size = 0;
+	this->chunk = 0;
+	this->high_water = 0;
+
+	auto max_chunks = (max_vertices + this->vertices_per_chunk - 1) / this->vertices_per_chunk;
+	arr_init(&chunks, max_chunks);
+}
+
+// Persistent storage is a single chunk of mapped memory, which moves to a new region every submit
+void GpuVertexStorage::map(u8* data) {
+	if (!chunks.size) {
+		auto mapped = arr_push(&chunks);
+		mapped->first = 0;
+		mapped->size = 0;
+	}
+
+	chunks[0]->data = data;
+}
+
+u8* GpuVertexStorage::reserve(u32 count) {
+	assert(count <= vertices_per_chunk);
+	assert(size + count <= capacity);
+
+	// Move on to the next chunk if this one can't fit the whole reservation, and allocate it if the storage has
+	// never gotten this far before
+	if (!chunks.size || chunks[chunk]->size + count > vertices_per_chunk) {
+		if (chunks.size) chunk++;
+		if (chunk == chunks.size) {
+			auto allocated = arr_push(&chunks);
+			allocated->data = (u8*)ma_alloc(&standard_allocator, vertices_per_chunk * vertex_size);
+		}
+
+		chunks[chunk]->first = size;
+		chunks[chunk]->size = 0;
+	}
+
+	auto current = chunks[chunk];
+	auto data = current->data + current->size * vertex_size;
+	current->size += count;
+	size += count;
+	high_water = std::max(high_water, size);
+
+	return data;
+}
+
+// Appends vertices that don't need to stay contiguous, filling each chunk before moving on to the next
+void GpuVertexStorage::write(u8* data, u32 count) {
+	while (count) {
+		u32 room = vertices_per_chunk;
+		if (chunks.size && chunks[chunk]->size < vertices_per_chunk) room -= chunks[chunk]->size;
+
+		auto num_vertices = std::min(count, room);
+		copy_memory(data, reserve(num_vertices), num_vertices * vertex_size);
+		data += num_vertices * vertex_size;
+		count -= num_vertices;
+	}
+}
+
+void GpuVertexStorage::copy(u32 index, u32 count, u8* destination) {
+	for (u32 i = 0; i < chunks.size && i <= chunk && count; i++) {
+		auto source = chunks[i];
+		if (index >= source->first + source->size) continue;
+
+		auto offset = index - source->first;
+		auto num_vertices = std::min(count, source->size - offset);
+		copy_memory(source->data + offset * vertex_size, destination, num_vertices * vertex_size);
+
+		destination += num_vertices * vertex_size;
+		index += num_vertices;
+		count -= num_vertices;
+	}
+}
+
+void GpuVertexStorage::clear() {
+	size = 0;
+	chunk = 0;
+	if (chunks.size) {
+		chunks[0]->first = 0;
+		chunks[0]->size = 0;
+	}
+}
+
+u32 GpuVertexStorage::byte_size() {
+	return size * vertex_size;
+}
+
+
 
 ////////////////
 // GPU SHADER //
@@ -678,15 +969,52 @@ u32 vertex_buffer_byte_size(VertexBuffer* buffer) {
 GpuShader* gpu_shader_create(GpuShaderDescriptor descriptor) {
 	auto shader = arr_push(&render.shaders);
 	shader->init(descriptor);
+	render.builtin_shaders.on_shader_created(shader, gpu_shader_get_handle(shader));
 	return shader;
 }
 
 GpuShader* gpu_shader_find(const char* name) {
+	return gpu_shader_from_handle(gpu_shader_find_handle(name));
+}
+
+GpuShaderHandle gpu_shader_find_handle(const char* name) {
+	if (!name) return 0;
+
+	auto hash = hash_label(name);
 	arr_for(render.shaders, shader) {
-		if (!strncmp(shader->name, name, MAX_PATH_LEN)) return shader;
+		if (shader->hash == hash) return gpu_shader_get_handle(shader);
 	}
 
-	return nullptr;
+	return 0;
+}
+
+GpuShaderHandle gpu_shader_get_handle(GpuShader* shader) {
+	if (!shader) return 0;
+	return arr_indexof(&render.shaders, shader) + 1;
+}
+
+GpuShader* gpu_shader_from_handle(GpuShaderHandle handle) {
+	if (!handle) return nullptr;
+	return render.shaders[handle - 1];
+}
+
+void GpuBuiltinShaders::on_shader_created(GpuShader* shader, GpuShaderHandle handle) {
+	struct Builtin {
+		const char* name;
+		GpuShaderHandle* handle;
+	};
+
+	Builtin builtins [] = {
+		{ "solid",        &solid },
+		{ "sprite",       &sprite },
+		{ "sprite_array", &sprite_array },
+		{ "text",         &text },
+		{ "sdf_instance", &sdf_instance },
+	};
+
+	for (auto& builtin : builtins) {
+		if (shader->hash == hash_label(builtin.name)) *builtin.handle = handle;
+	}
 }
 
 
@@ -728,14 +1056,27 @@ void gpu_render_target_bind(GpuRenderTarget* target) {
 	if (!target) return;
 	
 	glBindFramebuffer(GL_FRAMEBUFFER, target->handle);
+	render.gl_cache.framebuffer = target->handle;
 	glViewport(0, 0, target->size.x, target->size.y);
 	set_orthographic_projection(0, target->size.x, 0, target->size.y, -100.f, 100.f);
+	render.target = target;
+	gpu_sync_frame_globals();
 }
 
 GpuRenderTarget* gpu_acquire_swapchain() {
 	return render.targets[0];
 }
 
+GpuRenderTargetHandle gpu_render_target_get_handle(GpuRenderTarget* target) {
+	if (!target) return 0;
+	return arr_indexof(&render.targets, target) + 1;
+}
+
+GpuRenderTarget* gpu_render_target_from_handle(GpuRenderTargetHandle handle) {
+	if (!handle) return nullptr;
+	return render.targets[handle - 1];
+}
+
 void gpu_render_target_clear(GpuRenderTarget* target) {
 	if (!target) return;
 	
@@ -753,15 +1094,53 @@ void gpu_render_target_blit(GpuRenderTarget* source, GpuRenderTarget* destinatio
 
 void gpu_swap_buffers() {
 	glfwSwapBuffers(window.handle);
+	render.gl_cache.end_frame();
 }
 
 
 ////////////////////
 // COMMAND BUFFER //
 ////////////////////
+// Makes room for count more elements by doubling the array, but never past max_capacity. Returns false if that
+// still isn't enough.
+template<typename T>
+bool gpu_array_reserve(Array<T>* array, u32 count, u32 max_capacity) {
+	u64 needed = array->size + count;
+	if (needed <= array->capacity) return true;
+	if (needed > max_capacity) return false;
+
+	u64 capacity = std::max<u64>(array->capacity, 1);
+	while (capacity < needed) capacity *= 2;
+	capacity = std::min<u64>(capacity, max_capacity);
+
+	array->data = standard_allocator.realloc(array->data, capacity * sizeof(T));
+	array->capacity = capacity;
+	return true;
+}
+
 GpuCommandBufferBatched* gpu_create_command_buffer(GpuCommandBufferBatchedDescriptor descriptor) {
 	auto buffer = arr_push(&render.command_buffers);
 
+	VertexAttribute packed_attributes [] = {
+		{ 2, VertexAttributeKind::Float,         0 }, // Position
+		{ 4, VertexAttributeKind::U8Normalized,  0 }, // Color
+		{ 2, VertexAttributeKind::U16Normalized, 0 }, // UV
+	};
+	if (descriptor.packed_vertices) {
+		descriptor.vertex_attributes = packed_attributes;
+		descriptor.num_vertex_attributes = sizeof(packed_attributes) / sizeof(VertexAttribute);
+	}
+
+	// The texture array layer goes after everything else, so the rest of the vertex keeps its layout
+	if (descriptor.texture_arrays) {
+		auto attributes = bump_allocator.alloc<VertexAttribute>(descriptor.num_vertex_attributes + 1);
+		copy_memory(descriptor.vertex_attributes, attributes, descriptor.num_vertex_attributes * sizeof(VertexAttribute));
+		attributes[descriptor.num_vertex_attributes] = { 1, VertexAttributeKind::U32, 0 };
+
+		descriptor.vertex_attributes = attributes;
+		descriptor.num_vertex_attributes++;
+	}
+
 	// Collect vertex attributes, so we know how much memory we need
 	u32 vertex_size = 0;
 	for (u32 i = 0; i < descriptor.num_vertex_attributes; i++) {
@@ -770,24 +1149,80 @@ GpuCommandBufferBatched* gpu_create_command_buffer(GpuCommandBufferBatchedDescri
 		vertex_size += attribute.count * type_info.size;
 	}
 
-	// Set up the CPU buffers
-	vertex_buffer_init(&buffer->vertex_buffer, descriptor.max_vertices, vertex_size);
-	arr_init(&buffer->draw_calls, descriptor.max_draw_calls);
+	// Set up the CPU buffers. Persistent command buffers don't have a CPU copy of their vertices; their storage
+	// is pointed at mapped GPU memory below.
+	buffer->persistent = descriptor.persistent;
+	buffer->indexed_quads = descriptor.indexed_quads;
+	buffer->packed_vertices = descriptor.packed_vertices;
+	buffer->texture_arrays = descriptor.texture_arrays;
+	buffer->cull = descriptor.cull;
+	buffer->cull_counts = {};
+
+	auto vertices_per_chunk = descriptor.vertices_per_chunk;
+	if (!vertices_per_chunk) vertices_per_chunk = GpuVertexStorage::default_vertices_per_chunk;
+	if (buffer->persistent) vertices_per_chunk = descriptor.max_vertices;
+	buffer->vertices.init(descriptor.max_vertices, vertices_per_chunk, vertex_size);
+
+	using Descriptor = GpuCommandBufferBatchedDescriptor;
+	buffer->max_draw_calls = descriptor.max_draw_calls;
+	buffer->draw_calls_high_water = 0;
+	arr_init(&buffer->draw_calls, std::min(Descriptor::initial_draw_calls, descriptor.max_draw_calls));
+	arr_init(&buffer->buckets, GpuCommandBufferBatched::max_buckets);
+	buffer->bucket = 0;
+	fill_memory_u8(buffer->uniform_epochs, sizeof(buffer->uniform_epochs), 0);
+
+	buffer->max_uniforms = descriptor.max_uniforms;
+	if (!buffer->max_uniforms) buffer->max_uniforms = descriptor.max_draw_calls * Descriptor::uniforms_per_draw_call;
+	arr_init(&buffer->uniforms, std::min(Descriptor::initial_draw_calls * Descriptor::uniforms_per_draw_call, buffer->max_uniforms));
+
+	arr_init(&buffer->sorted_draw_calls, buffer->draw_calls.capacity);
+	arr_init(&buffer->submit_order, buffer->draw_calls.capacity);
+	buffer->sorted_vertices.data = nullptr;
+	buffer->sorted_vertices.size = 0;
+	buffer->sorted_vertices.capacity = 0;
+	buffer->sorted_vertices.vertex_size = vertex_size;
+	buffer->stats = {};
 
 	// Set up the GPU buffers
+	if (buffer->indexed_quads) {
+		gpu_quad_index_buffer_reserve(descriptor.max_vertices / GpuQuadIndexBuffer::vertices_per_quad);
+	}
+
 	glGenVertexArrays(1, &buffer->vao);
 	glGenBuffers(1, &buffer->vbo);
 
 	glBindVertexArray(buffer->vao);
 	glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+	if (buffer->indexed_quads) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.quad_indices.handle);
+	}
+
+	if (buffer->persistent) {
+		auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		auto region_size = descriptor.max_vertices * vertex_size;
+		auto stream_size = GpuVertexStream::num_regions * region_size;
+		glBufferStorage(GL_ARRAY_BUFFER, stream_size, nullptr, flags);
+
+		auto& stream = buffer->stream;
+		stream.mapped = (u8*)glMapBufferRange(GL_ARRAY_BUFFER, 0, stream_size, flags);
+		stream.region = 0;
+		for (u32 i = 0; i < GpuVertexStream::num_regions; i++) stream.fences[i] = nullptr;
 
-	u32 stride = sizeof(Vertex);
+		buffer->vertices.map(stream.mapped);
+	}
+
+	u32 stride = vertex_size;
 	u64 offset = 0;
 	for (u32 i = 0; i < descriptor.num_vertex_attributes; i++) {
 		auto attribute = descriptor.vertex_attributes[i];
 		auto type_info = GlTypeInfo::from_attribute(attribute.kind);
 		
-		glVertexAttribPointer(i, attribute.count, type_info.value, GL_FALSE, stride, (void*)offset);
+		if (type_info.integral) {
+			glVertexAttribIPointer(i, attribute.count, type_info.value, stride, (void*)offset);
+		}
+		else {
+			glVertexAttribPointer(i, attribute.count, type_info.value, type_info.normalized, stride, (void*)offset);
+		}
 		glEnableVertexAttribArray(i);
 		offset += attribute.count * type_info.size;
 	}
@@ -803,22 +1238,27 @@ DrawCall* gpu_command_buffer_alloc_draw_call(GpuCommandBufferBatched* command_bu
 
 	DrawCall draw_call;
 	fill_memory_u8(&draw_call, sizeof(DrawCall), 0);
-	draw_call.offset = command_buffer->vertex_buffer.size;
-	draw_call.count = 0;
+	draw_call.mode = DrawMode::Array;
+	draw_call.array.offset = command_buffer->vertices.size;
+	draw_call.array.count = 0;
 	draw_call.state = GlState();
+	draw_call.uniform_offset = command_buffer->uniforms.size;
+	draw_call.num_uniforms = 0;
 
 	if (command_buffer->draw_calls.size) {
-		draw_call.copy_from(arr_back(&command_buffer->draw_calls));
+		draw_call.copy_from(gpu_command_buffer_find_draw_call(command_buffer));
 	}
 
-	return arr_push(&command_buffer->draw_calls, draw_call);
+	return gpu_command_buffer_push_draw_call(command_buffer, draw_call);
 }
 
 DrawCall* gpu_command_buffer_find_draw_call(GpuCommandBufferBatched* command_buffer) {
 	assert(command_buffer);
 
-	if (!command_buffer->draw_calls.size) gpu_command_buffer_alloc_draw_call(command_buffer);
-	return arr_back(&command_buffer->draw_calls);
+	if (!command_buffer->draw_calls.size) return gpu_command_buffer_alloc_draw_call(command_buffer);
+
+	auto bucket = command_buffer->buckets[command_buffer->bucket];
+	return command_buffer->draw_calls[bucket->draw_call];
 }
 
 DrawCall* gpu_command_buffer_flush_draw_call(GpuCommandBufferBatched* command_buffer) {
@@ -828,70 +1268,670 @@ DrawCall* gpu_command_buffer_flush_draw_call(GpuCommandBufferBatched* command_bu
 	// shaders -- there's no way to batch those). However, if some operation just before that flushed the draw call, you end up
 	// with these empty draw calls sprinkled through the command buffer.
 	auto draw_call = gpu_command_buffer_find_draw_call(command_buffer);
-	if (!draw_call->count) return draw_call;
-	if (!draw_call->state.shader) return draw_call;
+	if (draw_call->is_empty()) return draw_call;
+	if (!draw_call->state.key.shader) return draw_call;
 
 	return gpu_command_buffer_alloc_draw_call(command_buffer);
 }
 
+// Records a draw call into the bucket for its render target and layer, and makes it that bucket's current draw call
+DrawCall* gpu_command_buffer_push_draw_call(GpuCommandBufferBatched* command_buffer, DrawCall& draw_call) {
+	auto bucket = gpu_command_buffer_find_bucket(command_buffer, &draw_call.state);
+	draw_call.bucket = arr_indexof(&command_buffer->buckets, bucket);
+	gpu_command_buffer_activate_bucket(command_buffer, draw_call.bucket);
+
+	// Past max_draw_calls, this doesn't grow and arr_push() asserts
+	gpu_array_reserve(&command_buffer->draw_calls, 1, command_buffer->max_draw_calls);
+	bucket->draw_call = command_buffer->draw_calls.size;
+	return arr_push(&command_buffer->draw_calls, draw_call);
+}
+
+// Moves recording to the bucket for the state's render target and layer. The bucket's last draw call is picked back
+// up if it would draw exactly the same way; otherwise, the bucket gets a new draw call with the given state.
+DrawCall* gpu_command_buffer_switch_bucket(GpuCommandBufferBatched* command_buffer, GlState* state) {
+	auto current = gpu_command_buffer_find_draw_call(command_buffer);
+	auto bucket = gpu_command_buffer_find_bucket(command_buffer, state);
+	auto index = static_cast<u32>(arr_indexof(&command_buffer->buckets, bucket));
+	if (index == command_buffer->bucket) return current;
+
+	DrawCall draw_call;
+	fill_memory_u8(&draw_call, sizeof(DrawCall), 0);
+	draw_call.mode = DrawMode::Array;
+	draw_call.array.offset = command_buffer->vertices.size;
+	draw_call.array.count = 0;
+	draw_call.primitive = current->primitive;
+	draw_call.state = *state;
+	draw_call.uniform_offset = command_buffer->uniforms.size;
+	draw_call.num_uniforms = 0;
+
+	if (bucket->draw_call != GpuLayerBucket::no_draw_call) {
+		auto previous = command_buffer->draw_calls[bucket->draw_call];
+		if (can_resume_draw_call(command_buffer, bucket, previous, &draw_call)) {
+			gpu_command_buffer_activate_bucket(command_buffer, index);
+			return previous;
+		}
+	}
+
+	return gpu_command_buffer_push_draw_call(command_buffer, draw_call);
+}
+
+GpuLayerBucket* gpu_command_buffer_find_bucket(GpuCommandBufferBatched* command_buffer, GlState* state) {
+	auto key = GpuLayerBucket::build_key(state);
+	arr_for(command_buffer->buckets, bucket) {
+		if (bucket->key == key) return bucket;
+	}
+
+	auto bucket = arr_push(&command_buffer->buckets);
+	bucket->key = key;
+	bucket->draw_call = GpuLayerBucket::no_draw_call;
+	bucket->uniform_epoch = 0;
+	return bucket;
+}
+
+void gpu_command_buffer_activate_bucket(GpuCommandBufferBatched* command_buffer, u32 index) {
+	if (index == command_buffer->bucket) return;
+
+	// Note where the bucket being left stands. If it never drew anything, drop its draw call, so that flipping
+	// between layers without drawing doesn't pile up empty ones.
+	if (command_buffer->bucket < command_buffer->buckets.size) {
+		auto bucket = command_buffer->buckets[command_buffer->bucket];
+		if (bucket->draw_call != GpuLayerBucket::no_draw_call) {
+			auto draw_call = command_buffer->draw_calls[bucket->draw_call];
+			bucket->uniform_epoch = command_buffer->uniform_epochs[draw_call->state.key.shader];
+
+			bool is_last = bucket->draw_call + 1 == command_buffer->draw_calls.size;
+			if (is_last && draw_call->is_empty() && !draw_call->num_uniforms) {
+				arr_pop(&command_buffer->draw_calls);
+				bucket->draw_call = GpuLayerBucket::no_draw_call;
+			}
+		}
+	}
+
+	command_buffer->bucket = index;
+}
+
+// A draw call can only keep going after other layers were recorded if everything it would be drawn with, uniforms
+// included, is still what the caller has set up.
+bool can_resume_draw_call(GpuCommandBufferBatched* command_buffer, GpuLayerBucket* bucket, DrawCall* previous, DrawCall* draw_call) {
+	if (previous->is_empty()) return false;
+	if (previous->primitive != draw_call->primitive) return false;
+	if (previous->state.key.value != draw_call->state.key.value) return false;
+
+	if (draw_call->state.key.scissor) {
+		if (!v2_equal(previous->state.scissor_region.position, draw_call->state.scissor_region.position)) return false;
+		if (!v2_equal(previous->state.scissor_region.dimension, draw_call->state.scissor_region.dimension)) return false;
+	}
+
+	return bucket->uniform_epoch == command_buffer->uniform_epochs[previous->state.key.shader];
+}
+
+// Uniforms are only ever added to a draw call whose uniforms are the tail of the arena
+Uniform* gpu_command_buffer_find_uniform(GpuCommandBufferBatched* command_buffer, DrawCall* draw_call, UniformId id) {
+	for (u32 i = 0; i < draw_call->num_uniforms; i++) {
+		auto uniform = command_buffer->uniforms[draw_call->uniform_offset + i];
+		if (uniform->id == id) return uniform;
+	}
+
+	return nullptr;
+}
+
+void gpu_command_buffer_add_uniform(GpuCommandBufferBatched* command_buffer, DrawCall* draw_call, Uniform& uniform) {
+	assert(draw_call->uniform_offset + draw_call->num_uniforms == command_buffer->uniforms.size);
+	gpu_array_reserve(&command_buffer->uniforms, 1, command_buffer->max_uniforms);
+	arr_push(&command_buffer->uniforms, uniform);
+	draw_call->num_uniforms++;
+	command_buffer->uniform_epochs[draw_call->state.key.shader]++;
+}
+
+// Vertices can only be appended to a draw call that reads them the same way (as plain triangles, or as indexed
+// quads), and whose vertices end where the new ones start; a draw call that was picked back up after recording
+// another layer doesn't. Otherwise, start a new one with the same state.
+DrawCall* gpu_command_buffer_find_vertex_draw_call(GpuCommandBufferBatched* command_buffer, DrawMode mode) {
+	auto draw_call = gpu_command_buffer_find_draw_call(command_buffer);
+	bool can_append = 
+		draw_call->mode == mode && 
+		draw_call->array.offset + draw_call->array.count == command_buffer->vertices.size;
+	if (can_append) return draw_call;
+
+	if (!draw_call->is_empty()) draw_call = gpu_command_buffer_alloc_draw_call(command_buffer);
+	draw_call->mode = mode;
+	draw_call->array.offset = command_buffer->vertices.size;
+	draw_call->array.count = 0;
+	return draw_call;
+}
+
 u8* gpu_command_buffer_alloc_vertex_data(GpuCommandBufferBatched* command_buffer, u32 count) {
 	assert(command_buffer);
 
-	auto draw_call = gpu_command_buffer_find_draw_call(command_buffer);
-	draw_call->count += count;
+	auto draw_call = gpu_command_buffer_find_vertex_draw_call(command_buffer, DrawMode::Array);
+	draw_call->array.count += count;
 
-	return vertex_buffer_reserve(&command_buffer->vertex_buffer, count);
+	return command_buffer->vertices.reserve(count);
+}
+
+u8* gpu_command_buffer_alloc_quad_data(GpuCommandBufferBatched* command_buffer, u32 count) {
+	assert(command_buffer);
+	assert(command_buffer->indexed_quads);
+
+	auto num_vertices = count * GpuQuadIndexBuffer::vertices_per_quad;
+	auto draw_call = gpu_command_buffer_find_vertex_draw_call(command_buffer, DrawMode::IndexedQuads);
+	draw_call->array.count += num_vertices;
+
+	return command_buffer->vertices.reserve(num_vertices);
 }
 
 u8* gpu_command_buffer_push_vertex_data(GpuCommandBufferBatched* command_buffer, void* data, u32 count) {
 	assert(command_buffer);
 
+	auto draw_call = gpu_command_buffer_find_vertex_draw_call(command_buffer, DrawMode::Array);
+	draw_call->array.count += count;
+
+	auto vertices = command_buffer->vertices.reserve(count);
+	copy_memory(data, vertices, count * command_buffer->vertices.vertex_size);
+	return vertices;
+}
+
+// Returns nullptr if the batch can't fit count more instances; callers that can draw fewer should check
+// gpu_instance_batch_find_room() first
+u8* gpu_command_buffer_alloc_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count) {
+	assert(command_buffer);
+	assert(batch);
+	if (batch->instances.size + count > batch->instances.capacity) return nullptr;
+
+	// Instances can be appended to the current draw call only if it's drawing from the same batch, and nothing
+	// else has been written to the batch in the meantime.
 	auto draw_call = gpu_command_buffer_find_draw_call(command_buffer);
-	draw_call->count += count;
+	bool can_append = 
+		draw_call->mode == DrawMode::Instanced && 
+		draw_call->instanced.batch == batch && 
+		draw_call->instanced.offset + draw_call->instanced.num_instances == batch->instances.size;
+
+	if (!can_append) {
+		draw_call = gpu_command_buffer_flush_draw_call(command_buffer);
+		draw_call->mode = DrawMode::Instanced;
+		draw_call->instanced.offset = batch->instances.size;
+		draw_call->instanced.num_instances = 0;
+		draw_call->instanced.batch = batch;
+	}
+
+	draw_call->instanced.num_instances += count;
+	return vertex_buffer_reserve(&batch->instances, count);
+}
+
+// Gives back the last count instances of the current draw call, for callers that reserved more than they ended up
+// writing
+void gpu_command_buffer_trim_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count) {
+	auto draw_call = gpu_command_buffer_find_draw_call(command_buffer);
+	assert(draw_call->mode == DrawMode::Instanced);
+	assert(draw_call->instanced.batch == batch);
+	assert(draw_call->instanced.num_instances >= count);
+
+	draw_call->instanced.num_instances -= count;
+	batch->instances.size -= count;
+}
+
+GpuCullRect gpu_command_buffer_find_cull_rect(GpuCommandBufferBatched* command_buffer) {
+	GpuCullRect cull = {};
+	if (!command_buffer->cull) return cull;
+
+	auto& state = gpu_command_buffer_find_draw_call(command_buffer)->state;
+	auto render_target = state.get_render_target();
+	if (!render_target) return cull;
 
-	return vertex_buffer_push(&command_buffer->vertex_buffer, data, count);
+	cull.enabled = true;
+	cull.min = state.key.world_space ? render.camera : Vector2();
+	cull.max = v2_add(cull.min, render_target->size);
+	return cull;
+}
+
+bool GpuCullRect::overlaps(Vector2 min, Vector2 max) {
+	if (!enabled) return true;
+	return max.x >= this->min.x && min.x <= this->max.x && max.y >= this->min.y && min.y <= this->max.y;
+}
+
+void gpu_command_buffer_count_culled(GpuCommandBufferBatched* command_buffer, u32 kept, u32 culled) {
+	command_buffer->cull_counts.kept += kept;
+	command_buffer->cull_counts.culled += culled;
 }
 
 void gpu_command_buffer_bind(GpuCommandBufferBatched* command_buffer) {
 	assert(command_buffer);
 	glBindVertexArray(command_buffer->vao);
 	glBindBuffer(GL_ARRAY_BUFFER, command_buffer->vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_byte_size(&command_buffer->vertex_buffer), command_buffer->vertex_buffer.data, GL_STREAM_DRAW); // @VERTEX
+
+	// Persistent command buffers already wrote their vertices into GPU memory. Otherwise, upload each chunk right
+	// after the one before it; most command buffers only ever fill one.
+	auto& vertices = command_buffer->vertices;
+	if (!command_buffer->persistent) {
+		if (!vertices.chunk) {
+			auto data = vertices.chunks.size ? vertices.chunks[0]->data : nullptr;
+			glBufferData(GL_ARRAY_BUFFER, vertices.byte_size(), data, GL_STREAM_DRAW); // @VERTEX
+		}
+		else {
+			glBufferData(GL_ARRAY_BUFFER, vertices.byte_size(), nullptr, GL_STREAM_DRAW);
+			for (u32 i = 0; i <= vertices.chunk; i++) {
+				auto chunk = vertices.chunks[i];
+				glBufferSubData(GL_ARRAY_BUFFER, chunk->first * vertices.vertex_size, chunk->size * vertices.vertex_size, chunk->data);
+			}
+		}
+	}
+
+	// Upload any instance data this command buffer draws from. Several draw calls usually share one batch, so
+	// only upload it once.
+	arr_for(command_buffer->draw_calls, draw_call) {
+		if (draw_call->mode != DrawMode::Instanced) continue;
+
+		auto batch = draw_call->instanced.batch;
+		if (batch->synced) continue;
+
+		gpu_buffer_sync(batch->buffer, batch->instances.data, vertex_buffer_byte_size(&batch->instances));
+		batch->synced = true;
+	}
 }
 
 void gpu_command_buffer_preprocess(GpuCommandBufferBatched* command_buffer) {
-	// @VERTEX
-	// arr_for(command_buffer->draw_calls, draw_call) {
-	// 	if (!draw_call->count) continue;
-		
-	// 	for (int i = 0; i < draw_call->count; i++) {
-	// 		auto vertex =  command_buffer->vertex_buffer[draw_call->offset + i];
-	// 		draw_call->average_y += vertex->position.y;
-	// 	}
+	auto& stats = command_buffer->stats;
+	stats = {};
+
+	// Empty draw calls are never rendered, so their uniforms never reach the GPU; drop them up front.
+	arr_for(command_buffer->buckets, bucket) {
+		bucket->num_draw_calls = 0;
+	}
+
+	command_buffer->draw_calls_high_water = std::max<u32>(command_buffer->draw_calls_high_water, command_buffer->draw_calls.size);
+
+	u32 num_draw_calls = 0;
+	arr_for(command_buffer->draw_calls, draw_call) {
+		if (draw_call->is_empty()) continue;
+		command_buffer->buckets[draw_call->bucket]->num_draw_calls++;
+		*command_buffer->draw_calls[num_draw_calls++] = *draw_call;
+	}
+	command_buffer->draw_calls.size = num_draw_calls;
+	stats.draw_calls_recorded = num_draw_calls;
+
+	// Whenever layers were recorded in order, every draw call is already where its bucket puts it
+	bool in_order = gpu_command_buffer_place_buckets(command_buffer);
+
+	// A draw call only stores the uniforms that were set while it was current and inherits the rest from
+	// whatever ran before it, so they have to be made explicit before anything can be reordered.
+	if (!in_order && gpu_command_buffer_resolve_uniforms(command_buffer)) {
+		gpu_command_buffer_gather(command_buffer);
+		stats.sorted = true;
+	}
+
+	gpu_command_buffer_merge(command_buffer);
+	stats.draw_calls_submitted = command_buffer->draw_calls.size;
+	gpu_command_buffer_count_layers(command_buffer);
+
+	stats.vertices_high_water = command_buffer->vertices.high_water;
+	stats.max_vertices = command_buffer->vertices.capacity;
+	stats.vertex_chunks = command_buffer->vertices.chunks.size;
+	stats.draw_calls_high_water = command_buffer->draw_calls_high_water;
+	stats.max_draw_calls = command_buffer->max_draw_calls;
+
+	stats.primitives_kept = command_buffer->cull_counts.kept;
+	stats.primitives_culled = command_buffer->cull_counts.culled;
+}
+
+bool gpu_command_buffer_resolve_uniforms(GpuCommandBufferBatched* command_buffer) {
+	// Uniforms are per-program, so a draw call sees the last value set for its shader
+	constexpr u32 max_shaders = GpuCommandBufferBatched::max_shader_handles;
+	i32 last_draw_call [max_shaders];
+	for (u32 i = 0; i < max_shaders; i++) last_draw_call[i] = -1;
+
+	// Resolve into a copy, so that the command buffer is untouched if the uniform arena runs out of room
+	arr_clear(&command_buffer->sorted_draw_calls);
+	gpu_array_reserve(&command_buffer->sorted_draw_calls, command_buffer->draw_calls.size, command_buffer->max_draw_calls);
+	auto& uniforms = command_buffer->uniforms;
+	auto recorded_uniforms = uniforms.size;
+
+	for (u32 index = 0; index < command_buffer->draw_calls.size; index++) {
+		auto draw_call = arr_push(&command_buffer->sorted_draw_calls, *command_buffer->draw_calls[index]);
+		auto shader = draw_call->state.key.shader;
+
+		u32 num_inherited = 0;
+		u32 inherited_offset = 0;
+		if (last_draw_call[shader] >= 0) {
+			auto previous = command_buffer->sorted_draw_calls[last_draw_call[shader]];
+			num_inherited = previous->num_uniforms;
+			inherited_offset = previous->uniform_offset;
+		}
+
+		if (!gpu_array_reserve(&uniforms, num_inherited + draw_call->num_uniforms, command_buffer->max_uniforms)) {
+			tdns_log.write("%s: uniform arena is full, submitting draw calls unsorted; max_uniforms = %d", __func__, command_buffer->max_uniforms);
+			uniforms.size = recorded_uniforms;
+			return false;
+		}
+
+		u32 resolved_offset = uniforms.size;
+		arr_push(&uniforms, uniforms.data + inherited_offset, num_inherited);
+
+		for (u32 i = 0; i < draw_call->num_uniforms; i++) {
+			auto uniform = uniforms[draw_call->uniform_offset + i];
+
+			auto resolved = arr_view(uniforms.data + resolved_offset, uniforms.size - resolved_offset);
+			bool found = false;
+			arr_for(resolved, inherited) {
+				if (inherited->id != uniform->id) continue;
+				*inherited = *uniform;
+				found = true;
+				break;
+			}
+
+			if (!found) arr_push(&uniforms, *uniform);
+		}
+
+		draw_call->uniform_offset = resolved_offset;
+		draw_call->num_uniforms = uniforms.size - resolved_offset;
+		last_draw_call[shader] = index;
+	}
+
+	return true;
+}
+
+// Works out where each draw call lands when buckets are submitted in key order, and returns whether that's where it
+// already is.
+bool gpu_command_buffer_place_buckets(GpuCommandBufferBatched* command_buffer) {
+	// There are only ever a handful of buckets, so an insertion sort is plenty
+	auto& buckets = command_buffer->buckets;
+	u32 order [GpuCommandBufferBatched::max_buckets];
+	for (u32 i = 0; i < buckets.size; i++) {
+		u32 j = i;
+		while (j && buckets[order[j - 1]]->key > buckets[i]->key) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	u32 offset = 0;
+	for (u32 i = 0; i < buckets.size; i++) {
+		auto bucket = buckets[order[i]];
+		bucket->submit_offset = offset;
+		offset += bucket->num_draw_calls;
+	}
+
+	bool in_order = true;
+	arr_clear(&command_buffer->submit_order);
+	gpu_array_reserve(&command_buffer->submit_order, command_buffer->draw_calls.size, command_buffer->max_draw_calls);
+	for (u32 index = 0; index < command_buffer->draw_calls.size; index++) {
+		auto bucket = buckets[command_buffer->draw_calls[index]->bucket];
+		auto destination = bucket->submit_offset++;
+		arr_push(&command_buffer->submit_order, destination);
+		if (destination != index) in_order = false;
+	}
+
+	return in_order;
+}
 
-	// 	draw_call->average_y /= draw_call->count;
-	// }
+void gpu_command_buffer_gather(GpuCommandBufferBatched* command_buffer) {
+	// Move each of the resolved draw calls into its bucket's slot
+	for (u32 index = 0; index < command_buffer->sorted_draw_calls.size; index++) {
+		auto destination = *command_buffer->submit_order[index];
+		*command_buffer->draw_calls[destination] = *command_buffer->sorted_draw_calls[index];
+	}
+
+	// Persistent buffers are written straight into a write-only mapping, which can't be read back. Their draw
+	// calls keep the offsets they were recorded with; only the order they're submitted in changes.
+	if (command_buffer->persistent) return;
+
+	// Lay the vertices out in the new order too, so that neighbouring draw calls can be merged
+	auto& vertices = command_buffer->vertices;
+	auto& sorted_vertices = command_buffer->sorted_vertices;
+	if (sorted_vertices.capacity < vertices.size) {
+		sorted_vertices.data = standard_allocator.realloc(sorted_vertices.data, vertices.size * vertices.vertex_size);
+		sorted_vertices.capacity = vertices.size;
+	}
+
+	vertex_buffer_clear(&sorted_vertices);
+	arr_for(command_buffer->draw_calls, draw_call) {
+		if (draw_call->mode == DrawMode::Instanced) continue;
+
+		auto offset = sorted_vertices.size;
+		vertices.copy(draw_call->array.offset, draw_call->array.count, vertex_buffer_reserve(&sorted_vertices, draw_call->array.count));
+		draw_call->array.offset = offset;
+	}
+
+	// Then write them back, which also packs them into as few chunks as possible
+	vertices.clear();
+	vertices.write(sorted_vertices.data, sorted_vertices.size);
+}
+
+void gpu_command_buffer_merge(GpuCommandBufferBatched* command_buffer) {
+	if (!command_buffer->draw_calls.size) return;
+
+	u32 num_draw_calls = 1;
+	for (u32 index = 1; index < command_buffer->draw_calls.size; index++) {
+		auto previous = command_buffer->draw_calls[num_draw_calls - 1];
+		auto draw_call = command_buffer->draw_calls[index];
+
+		if (can_merge_draw_calls(command_buffer, previous, draw_call)) {
+			if (draw_call->mode == DrawMode::Instanced) previous->instanced.num_instances += draw_call->instanced.num_instances;
+			else previous->array.count += draw_call->array.count;
+			continue;
+		}
+
+		*command_buffer->draw_calls[num_draw_calls++] = *draw_call;
+	}
+
+	command_buffer->draw_calls.size = num_draw_calls;
+}
+
+bool can_merge_draw_calls(GpuCommandBufferBatched* command_buffer, DrawCall* previous, DrawCall* draw_call) {
+	if (previous->primitive != draw_call->primitive) return false;
+	if (previous->mode != draw_call->mode) return false;
+
+	// Layers only decide the order; anything else in the key is real GL state
+	GlStateKey ignored;
+	ignored.value = 0;
+	ignored.layer = ~0u;
+	if ((previous->state.key.value ^ draw_call->state.key.value) & ~ignored.value) return false;
+
+	if (draw_call->state.key.scissor) {
+		if (!v2_equal(previous->state.scissor_region.position, draw_call->state.scissor_region.position)) return false;
+		if (!v2_equal(previous->state.scissor_region.dimension, draw_call->state.scissor_region.dimension)) return false;
+	}
+
+	if (draw_call->mode == DrawMode::Instanced) {
+		if (previous->instanced.batch != draw_call->instanced.batch) return false;
+		if (previous->instanced.offset + previous->instanced.num_instances != draw_call->instanced.offset) return false;
+	}
+	else {
+		if (previous->array.offset + previous->array.count != draw_call->array.offset) return false;
+	}
+
+	// The merged draw call uses the first draw call's uniforms, so it must already agree with everything the
+	// second one set.
+	for (u32 i = 0; i < draw_call->num_uniforms; i++) {
+		auto uniform = command_buffer->uniforms[draw_call->uniform_offset + i];
+		auto previous_uniform = gpu_command_buffer_find_uniform(command_buffer, previous, uniform->id);
+		if (!previous_uniform) return false;
+		if (!are_uniforms_equal(*uniform, *previous_uniform)) return false;
+	}
+
+	return true;
+}
 
-	// qsort(command_buffer->draw_calls.data, command_buffer->draw_calls.size, sizeof(DrawCall), &DrawCall::compare);
+GpuCommandBufferStats gpu_command_buffer_check_stats(GpuCommandBufferBatched* command_buffer) {
+	return command_buffer->stats;
+}
+
+void gpu_command_buffer_count_layers(GpuCommandBufferBatched* command_buffer) {
+	auto& stats = command_buffer->stats;
+	arr_for(command_buffer->draw_calls, draw_call) {
+		auto layer = draw_call->state.get_layer();
+
+		// Draw calls are in layer order, save for when the uniform arena filled up and they went out unsorted
+		GpuLayerStats* layer_stats = nullptr;
+		for (u32 i = 0; i < stats.num_layers; i++) {
+			if (stats.layers[i].layer == layer) layer_stats = &stats.layers[i];
+		}
+
+		if (!layer_stats) {
+			if (stats.num_layers == GpuCommandBufferStats::max_layers) continue;
+			layer_stats = &stats.layers[stats.num_layers++];
+			layer_stats->layer = layer;
+			layer_stats->draw_calls = 0;
+		}
+
+		layer_stats->draw_calls++;
+	}
+}
+
+u64 GpuLayerBucket::build_key(GlState* state) {
+	// Flip the sign bit, so that negative layers sort below positive ones
+	u64 render_target = state->key.render_target;
+	u64 layer = static_cast<u32>(state->key.layer) ^ 0x80000000;
+	return (render_target << 32) | layer;
 }
 
 void gpu_command_buffer_render(GpuCommandBufferBatched* command_buffer) {
+	auto& gl_cache = render.gl_cache;
+	gl_cache.invalidate();
+
 	GlStateDiff state_diff;
+	auto base_vertex = gpu_command_buffer_base_vertex(command_buffer);
 	arr_for(command_buffer->draw_calls, draw_call) {
-		if (!draw_call->count) continue;
+		if (draw_call->is_empty()) continue;
 			
-		state_diff.apply(&draw_call->state);
+		state_diff.apply(&draw_call->state, command_buffer->uniforms.data + draw_call->uniform_offset, draw_call->num_uniforms);
 		auto primitive = convert_draw_primitive(draw_call->primitive);
-		glDrawArrays(primitive, draw_call->offset, draw_call->count);
+		if (draw_call->mode == DrawMode::Array) {
+			gl_cache.bind_vertex_array(command_buffer->vao);
+			glDrawArrays(primitive, base_vertex + draw_call->array.offset, draw_call->array.count);
+		}
+		else if (draw_call->mode == DrawMode::IndexedQuads) {
+			auto num_indices = draw_call->array.count / GpuQuadIndexBuffer::vertices_per_quad * GpuQuadIndexBuffer::indices_per_quad;
+			gl_cache.bind_vertex_array(command_buffer->vao);
+			glDrawElementsBaseVertex(primitive, num_indices, render.quad_indices.index_type, nullptr, base_vertex + draw_call->array.offset);
+		}
+		else if (draw_call->mode == DrawMode::Instanced) {
+			auto batch = draw_call->instanced.batch;
+			gl_cache.bind_vertex_array(batch->vertex_layout->vao);
+			glDrawArraysInstancedBaseInstance(primitive, 0, batch->vertices_per_instance, draw_call->instanced.num_instances, draw_call->instanced.offset);
+		}
+	}
+
+	// Leave the command buffer's VAO bound, like gpu_command_buffer_bind() did
+	gl_cache.bind_vertex_array(command_buffer->vao);
+
+	// Instance data only lives for one submit, same as vertex data
+	arr_for(command_buffer->draw_calls, draw_call) {
+		if (draw_call->mode != DrawMode::Instanced) continue;
+
+		vertex_buffer_clear(&draw_call->instanced.batch->instances);
+		draw_call->instanced.batch->synced = false;
 	}
 		
 	arr_clear(&command_buffer->draw_calls);
-	vertex_buffer_clear(&command_buffer->vertex_buffer); // @VERTEX
+	arr_clear(&command_buffer->uniforms);
+	arr_clear(&command_buffer->buckets);
+	command_buffer->bucket = 0;
+	command_buffer->cull_counts = {};
+	command_buffer->vertices.clear(); // @VERTEX
+	gpu_command_buffer_advance_stream(command_buffer);
+}
+
+void gpu_command_buffer_advance_stream(GpuCommandBufferBatched* command_buffer) {
+	if (!command_buffer->persistent) return;
+
+	// Fence off the region that was just drawn from, then move to the oldest one and make sure the GPU is done
+	// reading it before the CPU starts writing into it.
+	auto& stream = command_buffer->stream;
+	stream.fences[stream.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stream.region = (stream.region + 1) % GpuVertexStream::num_regions;
+
+	auto& fence = stream.fences[stream.region];
+	if (fence) {
+		while (true) {
+			auto result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) break;
+			if (result == GL_WAIT_FAILED) {
+				tdns_log.write("%s: glClientWaitSync failed; region = %d", __func__, stream.region);
+				break;
+			}
+		}
+
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	auto& vertices = command_buffer->vertices;
+	vertices.map(stream.mapped + stream.region * vertices.capacity * vertices.vertex_size);
+}
+
+void gpu_quad_index_buffer_reserve(u32 max_quads) {
+	auto& quad_indices = render.quad_indices;
+	if (max_quads <= quad_indices.max_quads) return;
+
+	// Use 16-bit indices when every vertex a draw call could reference fits
+	bool wide = max_quads * GpuQuadIndexBuffer::vertices_per_quad > std::numeric_limits<u16>::max() + 1;
+	quad_indices.index_type = wide ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+	quad_indices.max_quads = max_quads;
+
+	auto num_indices = max_quads * GpuQuadIndexBuffer::indices_per_quad;
+	auto index_size = wide ? sizeof(u32) : sizeof(u16);
+	auto indices = bump_allocator.alloc<u8>(num_indices * index_size);
+
+	static u32 pattern [GpuQuadIndexBuffer::indices_per_quad] = { 0, 1, 2, 0, 2, 3 };
+	for (u32 quad = 0; quad < max_quads; quad++) {
+		for (u32 i = 0; i < GpuQuadIndexBuffer::indices_per_quad; i++) {
+			auto index = quad * GpuQuadIndexBuffer::vertices_per_quad + pattern[i];
+			auto slot = quad * GpuQuadIndexBuffer::indices_per_quad + i;
+			if (wide) reinterpret_cast<u32*>(indices)[slot] = index;
+			else      reinterpret_cast<u16*>(indices)[slot] = static_cast<u16>(index);
+		}
+	}
+
+	// Command buffers that already draw indexed quads keep the same buffer name, so only its storage changes.
+	// Don't let a bound VAO capture the binding.
+	glBindVertexArray(0);
+	if (!quad_indices.handle) glGenBuffers(1, &quad_indices.handle);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_indices.handle);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_indices * index_size, indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void gpu_sync_frame_globals() {
+	auto& buffer = render.frame_globals;
+	if (!buffer.handle) {
+		glGenBuffers(1, &buffer.handle);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer.handle);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameGlobals), nullptr, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, GpuFrameGlobalsBuffer::binding, buffer.handle);
+
+		// Make sure the first comparison below fails
+		buffer.uploaded.master_time = -1.f;
+	}
+
+	FrameGlobals globals;
+	globals.projection = render.projection;
+	globals.camera = render.camera;
+	globals.output_resolution = render.target ? render.target->size : window.content_area;
+	globals.native_resolution = window.native_resolution;
+	globals.master_time = engine.elapsed_time;
+	globals.padding = 0.f;
+
+	if (!std::memcmp(&globals, &buffer.uploaded, sizeof(FrameGlobals))) {
+		render.gl_cache.skip();
+		return;
+	}
+
+	render.gl_cache.issue();
+	buffer.uploaded = globals;
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer.handle);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameGlobals), &globals);
+}
+
+u32 gpu_command_buffer_base_vertex(GpuCommandBufferBatched* command_buffer) {
+	if (!command_buffer->persistent) return 0;
+	return command_buffer->stream.region * command_buffer->vertices.capacity;
 }
 
 void gpu_command_buffer_submit(GpuCommandBufferBatched* command_buffer) {
-	gpu_command_buffer_bind(command_buffer);
+	// Preprocessing may rewrite the vertex buffer, so it has to happen before the upload
 	gpu_command_buffer_preprocess(command_buffer);
+	gpu_command_buffer_bind(command_buffer);
 	gpu_command_buffer_render(command_buffer);	
 }
 
@@ -950,7 +1990,7 @@ DrawCall* gpu_commands_flush_draw_call(GpuCommandBuffer* command_buffer) {
 	// with these empty draw calls sprinkled through the command buffer.
 	auto draw_call = gpu_commands_find_draw_call(command_buffer);
 	if (!draw_call->count) return draw_call;
-	if (!draw_call->state.shader) return draw_call;
+	if (!draw_call->state.key.shader) return draw_call;
 
 	return gpu_commands_alloc_draw_call(command_buffer);
 }
@@ -1004,9 +2044,10 @@ void gpu_graphics_pipeline_submit(GpuGraphicsPipeline* pipeline) {
 
 DrawCall* gpu_graphics_pipeline_alloc_draw_call(GpuGraphicsPipeline* pipeline) {
 	assert(pipeline);
-	auto draw_call = gpu_command_buffer_alloc_draw_call(pipeline->command_buffer);
-	draw_call->state.render_target = pipeline->color_attachment.write;
-	return draw_call;
+	auto command_buffer = pipeline->command_buffer;
+	auto state = gpu_command_buffer_find_draw_call(command_buffer)->state;
+	state.set_render_target(pipeline->color_attachment.write);
+	return gpu_command_buffer_switch_bucket(command_buffer, &state);
 }
 
 
@@ -1088,7 +2129,7 @@ GpuVertexLayout* gpu_vertex_layout_create(GpuVertexLayoutDescriptor descriptor)
 			auto type_info = GlTypeInfo::from_attribute(attribute.kind);
 			
 			if (type_info.floating_point) {
-				glVertexAttribPointer(attribute_index, attribute.count, type_info.value, GL_FALSE, stride, (void*)offset);
+				glVertexAttribPointer(attribute_index, attribute.count, type_info.value, type_info.normalized, stride, (void*)offset);
 			}
 			else if (type_info.integral) {
 				glVertexAttribIPointer(attribute_index, attribute.count, type_info.value, stride, (void*)offset);
@@ -1114,16 +2155,189 @@ void gpu_vertex_layout_bind(GpuVertexLayout* layout) {
 }
 
 
-FM_LUA_EXPORT void gpu_render_sdf(GpuCommandBufferBatched* command_buffer, GpuVertexLayout* vertex_layout, u32 num_instances) {
-	auto draw_call = arr_back(&command_buffer->draw_calls);
+////////////////////
+// INSTANCE BATCH //
+////////////////////
+GpuInstanceBatch* gpu_instance_batch_create(GpuInstanceBatchDescriptor descriptor) {
+	auto batch = arr_push(&render.instance_batches);
+
+	u32 instance_size = 0;
+	for (u32 i = 0; i < descriptor.num_instance_attributes; i++) {
+		auto attribute = descriptor.instance_attributes[i];
+		auto type_info = GlTypeInfo::from_attribute(attribute.kind);
+		instance_size += attribute.count * type_info.size;
+	}
+
+	vertex_buffer_init(&batch->instances, descriptor.max_instances, instance_size);
+	batch->vertices_per_instance = descriptor.vertices_per_instance;
+	batch->synced = false;
+
+	GpuBufferDescriptor buffer_descriptor;
+	buffer_descriptor.kind = GpuBufferKind::Array;
+	buffer_descriptor.usage = GpuBufferUsage::Stream;
+	buffer_descriptor.size = descriptor.max_instances * instance_size;
+	batch->buffer = gpu_buffer_create(buffer_descriptor);
+
+	GpuBufferLayout buffer_layout;
+	buffer_layout.vertex_attributes = descriptor.instance_attributes;
+	buffer_layout.num_vertex_attributes = descriptor.num_instance_attributes;
+	buffer_layout.buffer = batch->buffer;
+
+	GpuVertexLayoutDescriptor layout_descriptor;
+	layout_descriptor.buffer_layouts = &buffer_layout;
+	layout_descriptor.num_buffer_layouts = 1;
+	batch->vertex_layout = gpu_vertex_layout_create(layout_descriptor);
+
+	return batch;
+}
+
+u32 gpu_instance_batch_find_room(GpuInstanceBatch* batch) {
+	return batch->instances.capacity - batch->instances.size;
+}
+
 
-	GlStateDiff diff;
-	diff.apply(&draw_call->state);
 
-	glBindVertexArray(vertex_layout->vao);
-	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, num_instances);
+/////////
+// SDF //
+/////////
+GpuInstanceBatch* find_sdf_batch(GpuCommandBufferBatched* command_buffer) {
+	arr_for(sdf_renderer.batches, batch) {
+		if (batch->command_buffer == command_buffer) return batch->instances;
+	}
 
-	arr_clear(&command_buffer->draw_calls);
+	if (sdf_renderer.batches.size == sdf_renderer.batches.capacity) return nullptr;
+
+	VertexAttribute attributes [6];
+	attributes[0] = { 2, VertexAttributeKind::Float,        1 }; // Position
+	attributes[1] = { 2, VertexAttributeKind::Float,        1 }; // Size
+	attributes[2] = { 4, VertexAttributeKind::U8Normalized, 1 }; // Color
+	attributes[3] = { 1, VertexAttributeKind::Float,        1 }; // Rotation
+	attributes[4] = { 1, VertexAttributeKind::Float,        1 }; // Edge thickness
+	attributes[5] = { 1, VertexAttributeKind::U32,          1 }; // Shape
+
+	GpuInstanceBatchDescriptor descriptor;
+	descriptor.instance_attributes = attributes;
+	descriptor.num_instance_attributes = 6;
+	descriptor.max_instances = SdfRenderer::max_instances;
+	descriptor.vertices_per_instance = 6;
+
+	auto batch = arr_push(&sdf_renderer.batches);
+	batch->command_buffer = command_buffer;
+	batch->instances = gpu_instance_batch_create(descriptor);
+	return batch->instances;
+}
+
+// Returns false if the shape couldn't be recorded at all; culled shapes count as drawn
+bool push_sdf_instance(Sdf shape, Vector2 position, Vector2 size, float rotation, Vector4 color, float edge_thickness) {
+	assert(render.pipeline);
+	auto command_buffer = render.pipeline->command_buffer;
+
+	auto shader = render.builtin_shaders.sdf_instance;
+	if (!shader) return false;
+
+	auto batch = find_sdf_batch(command_buffer);
+	if (!batch) return false;
+	if (!gpu_instance_batch_find_room(batch)) return false;
+
+	auto bounds = find_sdf_bounds(shape, size, edge_thickness);
+	if (cull_aabb(Vector2(position.x - bounds, position.y - bounds), Vector2(position.x + bounds, position.y + bounds))) return true;
+
+	set_active_shader_handle(shader);
+	set_draw_primitive(DrawPrimitive::Triangles);
+
+	auto instance = (SdfInstance*)gpu_command_buffer_alloc_instance_data(command_buffer, batch, 1);
+	instance->position = position;
+	instance->size = size;
+	instance->color = pack_rgba8(color);
+	instance->rotation = rotation;
+	instance->edge_thickness = edge_thickness;
+	instance->shape = static_cast<u32>(shape);
+	return true;
+}
+
+// The per-shape path from before shapes were instanced. Every shape sets its own uniforms, so each one is a draw
+// call of its own.
+void push_sdf_quad(Sdf shape, Vector2 position, Vector2 size, float rotation, Vector4 color, float edge_thickness) {
+	auto shader = gpu_shader_find("sdf");
+	if (!shader) {
+		tdns_log.write("%s: no sdf shader; shape will not be drawn, shape = %d", __func__, static_cast<i32>(shape));
+		return;
+	}
+
+	auto bounds = find_sdf_bounds(shape, size, edge_thickness);
+	if (cull_aabb(Vector2(position.x - bounds, position.y - bounds), Vector2(position.x + bounds, position.y + bounds))) return;
+
+	gpu_command_buffer_flush_draw_call(render.pipeline->command_buffer);
+
+	set_active_shader_ex(shader);
+	set_draw_primitive(DrawPrimitive::Triangles);
+
+	set_uniform_f32("edge_thickness", edge_thickness);
+	set_uniform_i32("shape", static_cast<i32>(shape));
+	if (shape == Sdf::Circle) {
+		set_uniform_vec2("point", position);
+		set_uniform_f32("radius", size.x);
+	}
+	else if (shape == Sdf::Ring) {
+		set_uniform_vec2("point", position);
+		set_uniform_f32("radius", size.x);
+		set_uniform_f32("inner_radius", size.y);
+	}
+	else if (shape == Sdf::Box) {
+		set_uniform_vec2("point", position);
+		set_uniform_vec2("size", size);
+	}
+	else if (shape == Sdf::OrientedBox) {
+		auto axis = Vector2(cosf(rotation) * size.x, sinf(rotation) * size.x);
+		set_uniform_vec2("center_a", v2_subtract(position, axis));
+		set_uniform_vec2("center_b", v2_add(position, axis));
+		set_uniform_f32("thickness", 2 * size.y);
+	}
+
+	push_quad(position.x - bounds, position.y + bounds, 2 * bounds, 2 * bounds, nullptr, color);
+}
+
+// Boxes can be rotated, so bound everything by a circle
+float find_sdf_bounds(Sdf shape, Vector2 size, float edge_thickness) {
+	float bounds = size.x;
+	if (shape == Sdf::Box || shape == Sdf::OrientedBox) bounds = v2_length(size);
+	return bounds + edge_thickness;
+}
+
+
+/////////////
+// CIRCLES //
+/////////////
+void CircleRenderer::init() {
+	u32 offset = 0;
+	for (u32 table = 0; table < num_tables; table++) {
+		offsets[table] = offset;
+
+		auto segments = (table + 1) * segment_step;
+		float32 theta = 2 * 3.14159f / segments;
+		for (u32 i = 0; i < segments; i++) {
+			unit_x[offset + i] = -sinf(theta * i);
+			unit_y[offset + i] = cosf(theta * i);
+		}
+		unit_x[offset + segments] = unit_x[offset];
+		unit_y[offset + segments] = unit_y[offset];
+
+		offset += segments + 1;
+	}
+	assert(offset == max_points);
+
+	sdf_radius = default_sdf_radius;
+}
+
+u32 CircleRenderer::find_segments(float radius) {
+	u32 segments = 5 * sqrt(std::max(radius, 0.f));
+	segments = (segments + segment_step - 1) / segment_step * segment_step;
+	return std::max(min_segments, std::min(segments, max_segments));
+}
+
+u32 CircleRenderer::find_offset(u32 segments) {
+	assert(segments % segment_step == 0);
+	return offsets[segments / segment_step - 1];
 }
 
 ////////////////////////
@@ -1139,11 +2353,16 @@ void init_render() {
 	arr_init(&render.gpu_buffers);
 	arr_init(&render.shaders);
 	arr_init(&render.vertex_layouts);
+	arr_init(&render.instance_batches);
+	arr_init(&sdf_renderer.batches);
+	circle_renderer.init();
+	render.gl_cache.invalidate();
 
 	auto swapchain = arr_push(&render.targets);
 	swapchain->handle = 0;
 	swapchain->color_buffer = 0;
 	swapchain->size = window.content_area;
+	render.target = swapchain;
 
 	auto reload_all_shaders = [](FileMonitor* file_monitor, FileChange* event, void* userdata) {
 		tdns_log.write("SHADER_RELOAD");
@@ -1160,17 +2379,24 @@ void init_render() {
 void DrawCall::copy_from(DrawCall* other) {
 	this->primitive = other->primitive;
 	this->state = other->state;
-	this->state.uniforms.clear();
 }
 
-void GlStateDiff::apply(GlState* state) {
+bool DrawCall::is_empty() {
+	if (mode == DrawMode::Array) return !array.count;
+	if (mode == DrawMode::IndexedQuads) return !array.count;
+	if (mode == DrawMode::Instanced) return !instanced.num_instances;
+	return true;
+}
+
+void GlStateDiff::apply(GlState* state, Uniform* uniforms, u32 num_uniforms) {
 	if (is_first_draw_call()) {
 		this->camera = HMM_Translate(HMM_V3(-render.camera.x, -render.camera.y, 0.f));
 		this->no_camera = HMM_M4D(1.0);
+		gpu_sync_frame_globals();
 	}
 
 	if (need_apply_scissor(state)) {
-		if (state->scissor) {
+		if (state->key.scissor) {
 			glEnable(GL_SCISSOR_TEST);
 
 			auto& p = state->scissor_region.position;
@@ -1183,9 +2409,9 @@ void GlStateDiff::apply(GlState* state) {
 	}
 
 	// Shader
-	set_shader_immediate_ex(state->shader);
+	set_shader_immediate_ex(state->get_shader());
 
-	if (state->world_space) {
+	if (state->key.world_space) {
 		set_uniform_immediate_mat4("view", this->camera);
 	}
 	else {
@@ -1193,10 +2419,11 @@ void GlStateDiff::apply(GlState* state) {
 	}
 
 	int num_textures = 0;
-	for (auto& uniform : state->uniforms) {
-		if (uniform.kind == UniformKind::Texture) {
-			glActiveTexture(GL_TEXTURE0 + num_textures);
-			glBindTexture(GL_TEXTURE_2D, uniform.texture);
+	for (u32 i = 0; i < num_uniforms; i++) {
+		auto& uniform = uniforms[i];
+		if (uniform.kind == UniformKind::Texture || uniform.kind == UniformKind::TextureArray) {
+			auto target = uniform.kind == UniformKind::Texture ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+			render.gl_cache.bind_texture(num_textures, target, uniform.texture);
 			uniform.texture = num_textures;
 			num_textures++;
 		}
@@ -1204,22 +2431,17 @@ void GlStateDiff::apply(GlState* state) {
 		set_uniform_immediate(uniform);
 	}
 
-	if (state->blend_enabled) {
-		glEnable(GL_BLEND);
-		glBlendFunc(state->blend_source, state->blend_dest);
+	render.gl_cache.set_blend(state->key.blend_enabled, state->get_blend_source(), state->get_blend_dest());
+
+	auto render_target = state->get_render_target();
+	if (render.gl_cache.framebuffer != render_target->handle) {
+		render.gl_cache.issue();
+		gpu_render_target_bind(render_target);
 	}
 	else {
-		glDisable(GL_BLEND);
+		render.gl_cache.skip();
 	}
 
-	if (!current || current->render_target != state->render_target) {
-		gpu_render_target_bind(state->render_target);
-	}
-	set_uniform_immediate_mat4("projection", render.projection);
-	set_uniform_immediate_vec2("output_resolution", state->render_target->size);
-	set_uniform_immediate_vec2("native_resolution", window.native_resolution);
-
-
 	this->current = state;
 
 }
@@ -1230,7 +2452,7 @@ bool GlStateDiff::is_first_draw_call() {
 
 bool GlStateDiff::need_apply_scissor(GlState* state) {
 	if (is_first_draw_call()) return true;
-	if (current->scissor != state->scissor) return true;
+	if (current->key.scissor != state->key.scissor) return true;
 	if (!v2_equal(current->scissor_region.position,  state->scissor_region.position)) return true;
 	if (!v2_equal(current->scissor_region.dimension, state->scissor_region.dimension)) return true;
 
@@ -1241,8 +2463,53 @@ bool GlStateDiff::need_apply_scissor(GlState* state) {
 //////////////
 // GL STATE //
 //////////////
+GlState::GlState() {
+	key.value = 0;
+	key.world_space = true;
+	key.blend_enabled = true;
+	set_blend(BlendMode::SRC_ALPHA, BlendMode::ONE_MINUS_SRC_ALPHA);
+	scissor_region = {};
+}
+
+GpuShader* GlState::get_shader() {
+	return gpu_shader_from_handle(key.shader);
+}
+
+void GlState::set_shader(GpuShader* shader) {
+	key.shader = gpu_shader_get_handle(shader);
+}
+
+GpuRenderTarget* GlState::get_render_target() {
+	return gpu_render_target_from_handle(key.render_target);
+}
+
+void GlState::set_render_target(GpuRenderTarget* render_target) {
+	key.render_target = gpu_render_target_get_handle(render_target);
+}
+
+i32 GlState::get_layer() {
+	return static_cast<i32>(static_cast<u32>(key.layer));
+}
+
+void GlState::set_layer(i32 layer) {
+	key.layer = static_cast<u32>(layer);
+}
+
+i32 GlState::get_blend_source() {
+	return convert_blend_mode(static_cast<BlendMode>(key.blend_source));
+}
+
+i32 GlState::get_blend_dest() {
+	return convert_blend_mode(static_cast<BlendMode>(key.blend_dest));
+}
+
+void GlState::set_blend(BlendMode source, BlendMode dest) {
+	key.blend_source = static_cast<u32>(source);
+	key.blend_dest = static_cast<u32>(dest);
+}
+
 void GlState::setup() {
-	if (this->scissor) {
+	if (key.scissor) {
 		glEnable(GL_SCISSOR_TEST);
 
 		auto& p = scissor_region.position;
@@ -1255,25 +2522,87 @@ void GlState::setup() {
 }
 
 void GlState::restore() {
-	if (this->scissor) {
+	if (key.scissor) {
 		glDisable(GL_SCISSOR_TEST);
 	}
 }
 
-Uniform* GlState::find_uniform(const char* name) {
-	for (auto& uniform : uniforms) {
-		if (!strncmp(uniform.name, name, Uniform::max_name_len)) return &uniform;
+void GlStateCache::invalidate() {
+	program = unknown;
+	vertex_array = unknown;
+	framebuffer = unknown;
+	blend_enabled = unknown;
+	blend_source = 0;
+	blend_dest = 0;
+	active_texture = unknown;
+	for (u32 i = 0; i < max_texture_units; i++) textures[i] = unknown;
+}
+
+void GlStateCache::end_frame() {
+	last_frame = frame;
+	frame = {};
+}
+
+void GlStateCache::issue() {
+	frame.issued++;
+}
+
+void GlStateCache::skip() {
+	frame.skipped++;
+}
+
+void GlStateCache::use_program(u32 program) {
+	if (this->program == program) return skip();
+
+	glUseProgram(program);
+	this->program = program;
+	issue();
+}
+
+void GlStateCache::bind_vertex_array(u32 vertex_array) {
+	if (this->vertex_array == vertex_array) return skip();
+
+	glBindVertexArray(vertex_array);
+	this->vertex_array = vertex_array;
+	issue();
+}
+
+void GlStateCache::bind_texture(u32 unit, u32 target, u32 texture) {
+	assert(unit < max_texture_units);
+	if (textures[unit] == texture) return skip();
+
+	if (active_texture != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_texture = unit;
 	}
 
-	return nullptr;
+	glBindTexture(target, texture);
+	textures[unit] = texture;
+	issue();
 }
 
-bool GlState::has_uniform(const char* name) {
-	return find_uniform(name) != nullptr;
+void GlStateCache::set_blend(bool enabled, i32 source, i32 dest) {
+	if (blend_enabled != (u32)enabled) {
+		if (enabled) glEnable(GL_BLEND);
+		else         glDisable(GL_BLEND);
+		blend_enabled = enabled;
+		issue();
+	}
+	else {
+		skip();
+	}
+
+	if (!enabled) return;
+	if (blend_source == source && blend_dest == dest) return skip();
+
+	glBlendFunc(source, dest);
+	blend_source = source;
+	blend_dest = dest;
+	issue();
 }
 
-void GlState::add_uniform(Uniform& uniform) {
-	uniforms.push(uniform);
+GlCallCounts gpu_check_gl_calls() {
+	return render.gl_cache.last_frame;
 }
 
 i32 convert_blend_mode(BlendMode blend_mode) {
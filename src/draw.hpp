@@ -74,6 +74,9 @@ u32 buffer_kind_to_barrier(GpuBufferKind kind);
 enum class VertexAttributeKind : u32 {
 	Float,
 	U32,
+	U8Normalized,  // Read by the shader as a float in [0, 1]
+	U16Normalized, // Read by the shader as a float in [0, 1]
+	Half,
 };
 
 struct GlTypeInfo {
@@ -81,9 +84,11 @@ struct GlTypeInfo {
 	u32 value;
 	bool floating_point;
 	bool integral;
+	bool normalized;
 
 	static GlTypeInfo from_attribute(VertexAttributeKind kind) {
 		GlTypeInfo info;
+		info.normalized = false;
 
 		if (kind  == VertexAttributeKind::Float) {
 			info.value = GL_FLOAT;
@@ -97,6 +102,26 @@ struct GlTypeInfo {
 			info.floating_point = false;
 			info.integral = true;		
 		}
+		else if (kind == VertexAttributeKind::U8Normalized) {
+			info.value = GL_UNSIGNED_BYTE;
+			info.size = sizeof(GLubyte);
+			info.floating_point = true;
+			info.integral = false;
+			info.normalized = true;
+		}
+		else if (kind == VertexAttributeKind::U16Normalized) {
+			info.value = GL_UNSIGNED_SHORT;
+			info.size = sizeof(GLushort);
+			info.floating_point = true;
+			info.integral = false;
+			info.normalized = true;
+		}
+		else if (kind == VertexAttributeKind::Half) {
+			info.value = GL_HALF_FLOAT;
+			info.size = sizeof(GLhalf);
+			info.floating_point = true;
+			info.integral = false;
+		}
 		else {
 			assert(false);
 		}
@@ -109,32 +134,91 @@ struct GlTypeInfo {
 enum class Sdf : i32 {
 	Circle = 0,
 	Ring = 1,
+	Box = 2,
+	OrientedBox = 3,
 };
 
 
 ///////////////////////////
 // DRAW CALLS & BATCHING //
 ///////////////////////////
+// Shaders and render targets live in fixed arrays that never shrink, so a 1-based index into them is a stable handle;
+// zero means none. Reloading a shader relinks the same GpuShader, so its handle survives reloads.
+typedef u32 GpuShaderHandle;
+typedef u32 GpuRenderTargetHandle;
+
 struct GpuRenderTarget;
+
+// Everything that decides whether two draw calls can share GL state, packed into one integer so that comparing
+// draw calls is a single compare. Shaders and render targets are stored as (one-based) indices into the renderer's
+// arrays, and blend factors as BlendMode rather than as GL enums; zero means unset.
+union GlStateKey {
+	struct {
+		u64 scissor       : 1;
+		u64 world_space   : 1;
+		u64 blend_enabled : 1;
+		u64 blend_source  : 5;
+		u64 blend_dest    : 5;
+		u64 render_target : 7;
+		u64 shader        : 8;
+		u64 layer         : 32;
+	};
+	u64 value;
+};
+
 struct GlState {
-	bool scissor = false;
-	Rect scissor_region = {};
-	GpuShader* shader = nullptr;
-	i32 layer = 0;
-	bool world_space = true;
-	bool blend_enabled = true;
-	i32 blend_source = GL_SRC_ALPHA;
-	i32 blend_dest = GL_ONE_MINUS_SRC_ALPHA;
-	GpuRenderTarget* render_target = nullptr;
-	
-	StackArray<Uniform, 32> uniforms;
+	GlStateKey key;
+	Rect scissor_region;
+
+	GlState();
+
+	GpuShader* get_shader();
+	void set_shader(GpuShader* shader);
+	GpuRenderTarget* get_render_target();
+	void set_render_target(GpuRenderTarget* render_target);
+	i32 get_layer();
+	void set_layer(i32 layer);
+	i32 get_blend_source();
+	i32 get_blend_dest();
+	void set_blend(BlendMode source, BlendMode dest);
 
 	void setup();
 	void restore();
-	void clear_uniforms();
-	bool has_uniform(const char* name);
-	void add_uniform(Uniform& uniform);
-	Uniform* find_uniform(const char* name);
+};
+
+struct GlCallCounts {
+	u32 issued;
+	u32 skipped;
+};
+
+// A mirror of the GL state that command buffers touch, so that only real changes reach the driver. Code outside
+// of command buffer rendering (ImGui, blits, compute passes) binds things directly, so the cache is invalidated
+// whenever a command buffer starts rendering. Uniform values are cached per program on GpuShader instead, since
+// every upload goes through set_uniform_immediate().
+struct GlStateCache {
+	static constexpr u32 unknown = 0xFFFFFFFF;
+	static constexpr u32 max_texture_units = 16;
+
+	u32 program;
+	u32 vertex_array;
+	u32 framebuffer;
+	u32 blend_enabled;
+	i32 blend_source;
+	i32 blend_dest;
+	u32 active_texture;
+	u32 textures [max_texture_units];
+
+	GlCallCounts frame;
+	GlCallCounts last_frame;
+
+	void invalidate();
+	void end_frame();
+	void issue();
+	void skip();
+	void use_program(u32 program);
+	void bind_vertex_array(u32 vertex_array);
+	void bind_texture(u32 unit, u32 target, u32 texture);
+	void set_blend(bool enabled, i32 source, i32 dest);
 };
 
 struct GlStateDiff {
@@ -142,16 +226,18 @@ struct GlStateDiff {
 	HMM_Mat4 no_camera;
 	GlState* current = nullptr;
 
-	void apply(GlState* state);
+	void apply(GlState* state, Uniform* uniforms, u32 num_uniforms);
 	bool is_first_draw_call();
 	bool need_apply_scissor(GlState* state);
 };
 
 enum class DrawMode {
 	Array,
-	Instanced
+	Instanced,
+	IndexedQuads, // Four vertices per quad in the array range, drawn with the shared quad index buffer
 };
 
+struct GpuInstanceBatch;
 struct DrawCall {
 	DrawPrimitive primitive;
 
@@ -165,12 +251,20 @@ struct DrawCall {
 		struct {
 			u32 offset;
 			u32 num_instances;
+			GpuInstanceBatch* batch;
 		} instanced;
 	};
 
 	GlState state;
+	u32 bucket; // Index of the layer bucket this was recorded into
+
+	// Uniforms set while this was the current draw call live in the command buffer's uniform arena; only the
+	// ones that were actually set are stored.
+	u32 uniform_offset;
+	u32 num_uniforms;
 
 	void copy_from(DrawCall* other);
+	bool is_empty();
 };
 
 
@@ -182,26 +276,43 @@ struct Vertex {
 	Vector4 color;
 	Vector2 uv;
 };
+
+// What push_vertex() and push_quad() write for command buffers created with packed_vertices; 16 bytes instead of 36.
+// 2D content never needs z, and the color and UVs are normalized integers, so both are clamped to [0, 1].
+struct PackedVertex {
+	Vector2 position;
+	u32 color;
+	u16 uv [2];
+
+	void pack(float px, float py, Vector2 uv, Vector4 color);
+};
  
-Vertex* push_vertex(float px, float py, Vector4 color);
-Vertex* push_vertex(float px, float py, Vector2 uv, Vector4 color);
+void push_vertex(float px, float py, Vector4 color);
+void push_vertex(float px, float py, Vector2 uv, Vector4 color);
 Vertex* alloc_vertices(u32 count);
 FM_LUA_EXPORT void push_quad(float px, float py, float dx, float dy, Vector2* uv, float opacity);
 void push_quad(float px, float py, float dx, float dy, Vector2* uv, Vector4 color);
+void push_quad_ex(Vector2* positions, Vector2* uvs, Vector4 color);
+void push_quad_ex(Vector2* positions, Vector2* uvs, Vector4 color, u32 layer);
 
 FM_LUA_EXPORT void draw_circle(float px, float py, float radius, Vector4 color);
 FM_LUA_EXPORT void draw_circle_sdf(float px, float py, float radius, Vector4 color, float edge_thickness);
+FM_LUA_EXPORT void set_circle_sdf_radius(float radius);
 FM_LUA_EXPORT void draw_ring_sdf(float px, float py, float inner_radius, float radius, Vector4 color, float edge_thickness);
+FM_LUA_EXPORT void draw_box_sdf(float px, float py, float dx, float dy, Vector4 color, float edge_thickness);
+FM_LUA_EXPORT void draw_oriented_box_sdf(Vector2 start, Vector2 end, float thickness, Vector4 color, float edge_thickness);
 FM_LUA_EXPORT void draw_image(const char* name, float px, float py);
 FM_LUA_EXPORT void draw_image_size(const char* name, float px, float py, float dx, float dy);
 FM_LUA_EXPORT void draw_image_ex(const char* name, float px, float py, float dx, float dy, float opacity);
 FM_LUA_EXPORT void draw_image_pro(uint32 texture, float px, float py, float dx, float dy, Vector2* uv, float opacity);
+void               draw_image_pro(Texture* texture, float px, float py, float dx, float dy, Vector2* uv, float opacity);
 FM_LUA_EXPORT void draw_text(const char* text, float px, float py, const char* font);
 FM_LUA_EXPORT void draw_text_ex(const char* text, float px, float py, Vector4 color, const char* font, float wrap, bool precise);
 FM_LUA_EXPORT void draw_prepared_text(PreparedText* prepared_text);
 FM_LUA_EXPORT void draw_line(Vector2 start, Vector2 end, float thickness, Vector4 color);
 FM_LUA_EXPORT void draw_quad_ex(float px, float py, float sx, float sy, Vector4 color);
 FM_LUA_EXPORT void draw_quad(Vector2 position, Vector2 size, Vector4 color);
+bool               cull_aabb(Vector2 min, Vector2 max);
 
 
 ///////////////////
@@ -228,6 +339,7 @@ u8*  vertex_buffer_at(VertexBuffer* vertex_buffer, u32 index);
 /////////
 struct GpuGraphicsPipeline;
 struct GpuBuffer;
+struct GpuVertexLayout;
 
 struct GpuUniformBinding {
 	UniformKind kind;
@@ -273,21 +385,231 @@ struct GpuRenderTarget {
 };
 
 
+// Vertex, draw call and uniform storage all start small and grow as a command buffer needs it; the maximums here
+// are caps, not what gets allocated up front.
 struct GpuCommandBufferBatchedDescriptor {
 	VertexAttribute* vertex_attributes;
 	u32 num_vertex_attributes = 0;
 	u32 max_vertices = 256 * 1024;
 	u32 max_draw_calls = 1024;
+	u32 max_uniforms = 0; // Zero means uniforms_per_draw_call for each draw call
+	u32 vertices_per_chunk = 0; // Zero means GpuVertexStorage::default_vertices_per_chunk
+	bool persistent = false; // Write vertices straight into persistently mapped GPU memory
+	bool indexed_quads = false; // Draw quads as four vertices with a shared index buffer, instead of six
+	bool packed_vertices = false; // Record PackedVertex instead of Vertex; vertex_attributes are ignored
+	bool texture_arrays = false; // Append a u32 texture array layer to every vertex, so sprites can span textures
+	bool cull = false; // Skip primitives that are entirely outside of the render target, before generating vertices
+	
+	static constexpr u32 uniforms_per_draw_call = 16;
+	static constexpr u32 initial_draw_calls = 64;
+};
+
+// Each (render target, layer) pair records into its own bucket, which remembers that layer's current draw call.
+// Switching layers only switches buckets, so callers can interleave layers without breaking up the batch that each
+// one is building. Draw calls are submitted bucket by bucket in (render target, layer) order, and in recording order
+// within a bucket.
+struct GpuLayerBucket {
+	static constexpr u32 no_draw_call = 0xFFFFFFFF;
+
+	u64 key;
+	u32 draw_call;     // The bucket's current draw call, as an index into the command buffer's draw calls
+	u32 uniform_epoch; // Uniform epoch of the current draw call's shader when the bucket was last switched away from
+
+	// Scratch space for gpu_command_buffer_preprocess()
+	u32 num_draw_calls;
+	u32 submit_offset;
+
+	static u64 build_key(GlState* state);
+};
+
+struct GpuLayerStats {
+	i32 layer;
+	u32 draw_calls;
+};
+
+struct GpuCommandBufferStats {
+	static constexpr u32 max_layers = 16;
+
+	u32 draw_calls_recorded;
+	u32 draw_calls_submitted;
+	bool sorted;
+
+	// Submitted draw calls per layer, lowest layer first
+	u32 num_layers;
+	GpuLayerStats layers [max_layers];
+
+	// The most the command buffer has ever used in one frame, against what it's allowed; for sizing the descriptor
+	u32 vertices_high_water;
+	u32 max_vertices;
+	u32 vertex_chunks;
+	u32 draw_calls_high_water;
+	u32 max_draw_calls;
+
+	u32 primitives_kept;
+	u32 primitives_culled;
+};
+
+// What the current draw call can see: its render target's rect, moved by the camera for world space draws. Only
+// command buffers created with cull have one.
+struct GpuCullRect {
+	Vector2 min;
+	Vector2 max;
+	bool enabled;
+
+	bool overlaps(Vector2 min, Vector2 max);
+};
+
+struct GpuCullCounts {
+	u32 kept;
+	u32 culled;
+};
+
+// Vertices are recorded into chunks, which are allocated the first time a command buffer gets that far and kept
+// from then on. A reservation never straddles two chunks, so whatever a caller asks for is contiguous in memory.
+// Vertex indices, which are what draw calls store, skip the unused tail of each chunk, so a draw call's vertices
+// are contiguous again once they're uploaded.
+struct GpuVertexChunk {
+	u8* data;
+	u32 first; // Index of the chunk's first vertex
+	u32 size;
 };
+
+struct GpuVertexStorage {
+	static constexpr u32 default_vertices_per_chunk = 16 * 1024;
+
+	Array<GpuVertexChunk> chunks;
+	u32 chunk; // The chunk being written to
+	u32 vertices_per_chunk;
+	u32 vertex_size;
+	u32 size;
+	u32 capacity;
+	u32 high_water;
+
+	void init(u32 max_vertices, u32 vertices_per_chunk, u32 vertex_size);
+	void map(u8* data);
+	u8*  reserve(u32 count);
+	void write(u8* data, u32 count);
+	void copy(u32 index, u32 count, u8* destination);
+	void clear();
+	u32  byte_size();
+};
+
+// Persistently mapped vertex storage, split into one region per submit in flight. The vertex storage is a single
+// chunk that points straight into the current region, and a fence keeps the CPU from writing a region the GPU may
+// still be reading from. Mapped storage can't grow, so persistent command buffers get all of max_vertices up front.
+struct GpuVertexStream {
+	static constexpr u32 num_regions = 3;
+
+	u8* mapped;
+	u32 region;
+	GLsync fences [num_regions];
+};
+
 struct GpuCommandBufferBatched {
-	VertexBuffer vertex_buffer;
+	static constexpr u32 max_buckets = 64;
+	static constexpr u32 max_shader_handles = 256; // GlStateKey stores shaders in eight bits
+
+	GpuVertexStorage vertices;
+	bool persistent;
+	bool indexed_quads;
+	bool packed_vertices;
+	bool texture_arrays;
+	bool cull;
+	GpuVertexStream stream;
+	GpuCullCounts cull_counts;
+
 	Array<DrawCall> draw_calls;
+	Array<Uniform> uniforms;
+	u32 max_draw_calls;
+	u32 max_uniforms;
+	u32 draw_calls_high_water;
+
+	Array<GpuLayerBucket> buckets;
+	u32 bucket; // The bucket that draw calls are currently recorded into
+
+	// Bumped whenever a uniform is recorded for a shader. A bucket's draw call can only be picked back up if nothing
+	// changed its shader's uniforms while other buckets were being recorded.
+	u32 uniform_epochs [max_shader_handles];
+
+	// Scratch space for gpu_command_buffer_preprocess()
+	Array<DrawCall> sorted_draw_calls;
+	Array<u32> submit_order;
+	VertexBuffer sorted_vertices;
+
+	GpuCommandBufferStats stats;
 
 	u32 vao;
 	u32 vbo;
 };
 
 
+// Per-instance data that gets recorded alongside a batched command buffer's vertices. Each instance is expanded
+// into vertices_per_instance vertices by the vertex shader, which only sees the instance attributes.
+struct GpuInstanceBatchDescriptor {
+	VertexAttribute* instance_attributes;
+	u32 num_instance_attributes = 0;
+	u32 max_instances = 64 * 1024;
+	u32 vertices_per_instance = 6;
+};
+struct GpuInstanceBatch {
+	VertexBuffer instances;
+	GpuBuffer* buffer;
+	GpuVertexLayout* vertex_layout;
+	u32 vertices_per_instance;
+	bool synced;
+};
+
+// SDF shapes are drawn as instances, so a run of them in one layer is a single draw call. sdf_instance.vertex expands
+// each one into a quad around the shape, and the fragment shader evaluates its distance function in local space.
+struct SdfInstance {
+	Vector2 position;     // Center; the midpoint for oriented boxes
+	Vector2 size;         // Radius for circles, outer and inner radius for rings, half extents for boxes
+	u32 color;            // RGBA8
+	float rotation;       // Radians, counterclockwise
+	float edge_thickness;
+	u32 shape;            // Sdf
+};
+
+// Instance data is cleared when a command buffer renders, so every command buffer that draws shapes gets its own
+// batch; otherwise rendering one would throw away shapes recorded into another.
+struct SdfBatch {
+	GpuCommandBufferBatched* command_buffer;
+	GpuInstanceBatch* instances;
+};
+
+struct SdfRenderer {
+	static constexpr u32 max_instances = 16 * 1024;
+
+	Array<SdfBatch, 16> batches;
+};
+SdfRenderer sdf_renderer;
+
+// draw_circle() rounds its segment count up to a multiple of segment_step, so the points on the unit circle for
+// every count it can use are computed once, up front. Past sdf_radius, a circle is a single SDF instance instead,
+// which is six vertices no matter how big it gets. Zero, the default, always tesselates; callers that want the
+// switch opt in with set_circle_sdf_radius().
+struct CircleRenderer {
+	static constexpr u32 segment_step = 4;
+	static constexpr u32 min_segments = 8;
+	static constexpr u32 max_segments = 128;
+	static constexpr u32 num_tables = max_segments / segment_step;
+	static constexpr u32 max_points = segment_step * num_tables * (num_tables + 1) / 2 + num_tables;
+	static constexpr float default_sdf_radius = 0.f;
+
+	// Each table is its segment count plus one points, starting at the top and going counterclockwise. The last
+	// point is the first one again, so no triangle has to wrap around.
+	float unit_x [max_points];
+	float unit_y [max_points];
+	u32 offsets [num_tables];
+	float sdf_radius;
+
+	void init();
+	u32 find_segments(float radius);
+	u32 find_offset(u32 segments);
+};
+CircleRenderer circle_renderer;
+
+
 struct GpuGraphicsPipelineDescriptor {
 	GpuColorAttachment color_attachment;
 	GpuCommandBufferBatched* command_buffer;
@@ -350,6 +672,50 @@ struct DefaultRenderer {
 };
 DefaultRenderer default_renderer;
 
+// Every quad uses the same six indices relative to its first vertex, so one static index buffer serves every
+// command buffer that draws indexed quads. It's sized for the largest of them.
+struct GpuQuadIndexBuffer {
+	static constexpr u32 indices_per_quad = 6;
+	static constexpr u32 vertices_per_quad = 4;
+
+	u32 handle;
+	u32 max_quads;
+	u32 index_type;
+};
+
+// Engine globals every shader reads through the FrameGlobals block in common.glsl. The layout has to match
+// std140, so keep the members in the same order as the GLSL and the struct a multiple of 16 bytes.
+struct FrameGlobals {
+	Matrix4 projection;
+	Vector2 camera;
+	Vector2 output_resolution;
+	Vector2 native_resolution;
+	float master_time;
+	float padding;
+};
+static_assert(sizeof(FrameGlobals) == 96, "FrameGlobals must match the std140 layout in common.glsl");
+
+// One uniform buffer bound at a fixed binding point for the whole run. It's only rewritten when the globals
+// actually change, which in practice is the first draw of each frame and each render target switch.
+struct GpuFrameGlobalsBuffer {
+	static constexpr u32 binding = 0;
+
+	u32 handle;
+	FrameGlobals uploaded;
+};
+
+// The shaders that the immediate draw functions use. They're resolved once, as the shaders are created, instead of
+// looking up a name on every primitive.
+struct GpuBuiltinShaders {
+	GpuShaderHandle solid;
+	GpuShaderHandle sprite;
+	GpuShaderHandle sprite_array;
+	GpuShaderHandle text;
+	GpuShaderHandle sdf_instance;
+
+	void on_shader_created(GpuShader* shader, GpuShaderHandle handle);
+};
+
 struct RenderEngine {
 	Array<GpuCommandBufferBatched, 32>  command_buffers;
 	Array<GpuCommandBuffer,        32>  commands;
@@ -358,8 +724,15 @@ struct RenderEngine {
 	Array<GpuBuffer,               32>  gpu_buffers;
 	Array<GpuShader,               128> shaders;
 	Array<GpuVertexLayout,         32>  vertex_layouts;
+	Array<GpuInstanceBatch,        32>  instance_batches;
+	GpuBuiltinShaders                   builtin_shaders;
+	GpuQuadIndexBuffer                  quad_indices;
+	GlStateCache                        gl_cache;
+	GpuFrameGlobalsBuffer               frame_globals;
 
 	GpuGraphicsPipeline* pipeline;
+	GpuShader* shader; // Whichever shader set_shader_immediate_ex() last bound
+	GpuRenderTarget* target; // Whichever target gpu_render_target_bind() last bound
 
 
 	Matrix4 projection;
@@ -385,8 +758,13 @@ FM_LUA_EXPORT void              gpu_commands_submit(GpuCommandBuffer* command_bu
 /////////
 FM_LUA_EXPORT GpuShader*               gpu_shader_create(GpuShaderDescriptor descriptor);
 FM_LUA_EXPORT GpuShader*               gpu_shader_find(const char* name);
+FM_LUA_EXPORT GpuShaderHandle          gpu_shader_find_handle(const char* name);
+FM_LUA_EXPORT GpuShaderHandle          gpu_shader_get_handle(GpuShader* shader);
+FM_LUA_EXPORT GpuShader*               gpu_shader_from_handle(GpuShaderHandle handle);
 FM_LUA_EXPORT GpuRenderTarget*         gpu_render_target_create(GpuRenderTargetDescriptor descriptor);
 FM_LUA_EXPORT GpuRenderTarget*         gpu_acquire_swapchain();
+FM_LUA_EXPORT GpuRenderTargetHandle    gpu_render_target_get_handle(GpuRenderTarget* target);
+FM_LUA_EXPORT GpuRenderTarget*         gpu_render_target_from_handle(GpuRenderTargetHandle handle);
 FM_LUA_EXPORT void                     gpu_render_target_bind(GpuRenderTarget* target);
 FM_LUA_EXPORT void                     gpu_render_target_clear(GpuRenderTarget* target);
 FM_LUA_EXPORT void                     gpu_render_target_blit(GpuRenderTarget* source, GpuRenderTarget* destination);
@@ -396,10 +774,36 @@ FM_LUA_EXPORT DrawCall*                gpu_command_buffer_find_draw_call(GpuComm
 FM_LUA_EXPORT DrawCall*                gpu_command_buffer_flush_draw_call(GpuCommandBufferBatched* command_buffer);
 FM_LUA_EXPORT u8*                      gpu_command_buffer_alloc_vertex_data(GpuCommandBufferBatched* command_buffer, u32 count);
 FM_LUA_EXPORT u8*                      gpu_command_buffer_push_vertex_data(GpuCommandBufferBatched* command_buffer, void* data, u32 count);
+FM_LUA_EXPORT u8*                      gpu_command_buffer_alloc_quad_data(GpuCommandBufferBatched* command_buffer, u32 count);
+FM_LUA_EXPORT u8*                      gpu_command_buffer_alloc_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count);
 FM_LUA_EXPORT void                     gpu_command_buffer_bind(GpuCommandBufferBatched* command_buffer);
 FM_LUA_EXPORT void                     gpu_command_buffer_preprocess(GpuCommandBufferBatched* command_buffer);
 FM_LUA_EXPORT void                     gpu_command_buffer_render(GpuCommandBufferBatched* command_buffer);
 FM_LUA_EXPORT void                     gpu_command_buffer_submit(GpuCommandBufferBatched* command_buffer);
+FM_LUA_EXPORT GpuCommandBufferStats    gpu_command_buffer_check_stats(GpuCommandBufferBatched* command_buffer);
+FM_LUA_EXPORT GlCallCounts             gpu_check_gl_calls();
+void                                   gpu_command_buffer_advance_stream(GpuCommandBufferBatched* command_buffer);
+DrawCall*                              gpu_command_buffer_find_vertex_draw_call(GpuCommandBufferBatched* command_buffer, DrawMode mode);
+DrawCall*                              gpu_command_buffer_push_draw_call(GpuCommandBufferBatched* command_buffer, DrawCall& draw_call);
+DrawCall*                              gpu_command_buffer_switch_bucket(GpuCommandBufferBatched* command_buffer, GlState* state);
+GpuLayerBucket*                        gpu_command_buffer_find_bucket(GpuCommandBufferBatched* command_buffer, GlState* state);
+void                                   gpu_command_buffer_activate_bucket(GpuCommandBufferBatched* command_buffer, u32 index);
+bool                                   can_resume_draw_call(GpuCommandBufferBatched* command_buffer, GpuLayerBucket* bucket, DrawCall* previous, DrawCall* draw_call);
+void                                   gpu_quad_index_buffer_reserve(u32 max_quads);
+void                                   gpu_sync_frame_globals();
+u32                                    gpu_command_buffer_base_vertex(GpuCommandBufferBatched* command_buffer);
+bool                                   gpu_command_buffer_resolve_uniforms(GpuCommandBufferBatched* command_buffer);
+bool                                   gpu_command_buffer_place_buckets(GpuCommandBufferBatched* command_buffer);
+void                                   gpu_command_buffer_gather(GpuCommandBufferBatched* command_buffer);
+void                                   gpu_command_buffer_merge(GpuCommandBufferBatched* command_buffer);
+void                                   gpu_command_buffer_count_layers(GpuCommandBufferBatched* command_buffer);
+template<typename T> bool              gpu_array_reserve(Array<T>* array, u32 count, u32 max_capacity);
+void                                   gpu_command_buffer_trim_instance_data(GpuCommandBufferBatched* command_buffer, GpuInstanceBatch* batch, u32 count);
+GpuCullRect                            gpu_command_buffer_find_cull_rect(GpuCommandBufferBatched* command_buffer);
+void                                   gpu_command_buffer_count_culled(GpuCommandBufferBatched* command_buffer, u32 kept, u32 culled);
+bool                                   can_merge_draw_calls(GpuCommandBufferBatched* command_buffer, DrawCall* previous, DrawCall* draw_call);
+Uniform*                               gpu_command_buffer_find_uniform(GpuCommandBufferBatched* command_buffer, DrawCall* draw_call, UniformId id);
+void                                   gpu_command_buffer_add_uniform(GpuCommandBufferBatched* command_buffer, DrawCall* draw_call, Uniform& uniform);
 FM_LUA_EXPORT GpuGraphicsPipeline*     gpu_graphics_pipeline_create(GpuGraphicsPipelineDescriptor descriptor);
 FM_LUA_EXPORT DrawCall*                gpu_graphics_pipeline_alloc_draw_call(GpuGraphicsPipeline* pipeline);
 FM_LUA_EXPORT void                     gpu_graphics_pipeline_begin_frame(GpuGraphicsPipeline* pipeline);
@@ -413,6 +817,13 @@ FM_LUA_EXPORT void                     gpu_buffer_sync_subdata(GpuBuffer* buffer
 FM_LUA_EXPORT void                     gpu_buffer_zero(GpuBuffer* buffer, u32 size);
 FM_LUA_EXPORT GpuVertexLayout*         gpu_vertex_layout_create(GpuVertexLayoutDescriptor descriptor);
 FM_LUA_EXPORT void                     gpu_vertex_layout_bind(GpuVertexLayout* layout);
+FM_LUA_EXPORT GpuInstanceBatch*        gpu_instance_batch_create(GpuInstanceBatchDescriptor descriptor);
+u32                                    gpu_instance_batch_find_room(GpuInstanceBatch* batch);
+GpuInstanceBatch*                      find_sdf_batch(GpuCommandBufferBatched* command_buffer);
+bool                                   push_sdf_instance(Sdf shape, Vector2 position, Vector2 size, float rotation, Vector4 color, float edge_thickness);
+void                                   push_sdf_quad(Sdf shape, Vector2 position, Vector2 size, float rotation, Vector4 color, float edge_thickness);
+void                                   draw_sdf(Sdf shape, Vector2 position, Vector2 size, float rotation, Vector4 color, float edge_thickness);
+float                                  find_sdf_bounds(Sdf shape, Vector2 size, float edge_thickness);
 
 FM_LUA_EXPORT void                     gpu_memory_barrier(GpuMemoryBarrier barrier);
 FM_LUA_EXPORT void                     gpu_dispatch_compute(GpuBuffer* buffer, u32 size);
@@ -423,9 +834,11 @@ FM_LUA_EXPORT void                     gpu_swap_buffers();
 //////////////////////////////////
 FM_LUA_EXPORT void    set_active_shader(const char* name);
 FM_LUA_EXPORT void    set_active_shader_ex(GpuShader* shader);
+FM_LUA_EXPORT void    set_active_shader_handle(GpuShaderHandle handle);
 FM_LUA_EXPORT void    set_draw_primitive(DrawPrimitive mode);
 FM_LUA_EXPORT void    set_orthographic_projection(float left, float right, float bottom, float top, float _near, float _far);
 FM_LUA_EXPORT void    set_uniform_texture(const char* name, i32 value);
+void                  set_uniform_texture_array(const char* name, i32 value);
 FM_LUA_EXPORT void    set_uniform_i32(const char* name, i32 value);
 FM_LUA_EXPORT void    set_uniform_f32(const char* name, float value);
 FM_LUA_EXPORT void    set_uniform_vec2(const char* name, Vector2 value);
@@ -450,6 +863,7 @@ FM_LUA_EXPORT void    log_gl_errors();
 // IMMEDIATE OPENGL CONFIGURATION //
 ////////////////////////////////////
 FM_LUA_EXPORT i32  find_uniform_index(const char* name);
+i32                find_uniform_index_ex(UniformId id, const char* name);
 FM_LUA_EXPORT void set_shader_immediate_ex(GpuShader* shader);
 FM_LUA_EXPORT void set_shader_immediate(const char* name);
 FM_LUA_EXPORT void set_uniform_immediate_mat4(const char* name, HMM_Mat4 value);
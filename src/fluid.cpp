@@ -204,7 +204,6 @@ void lf_draw(ArenaHandle handle) {
 
 	// Render the particles
 	set_shader_immediate("particle");
-	set_uniform_immediate_mat4("projection", render.projection);
 	set_uniform_immediate_mat4("view", HMM_Translate(HMM_V3(-render.camera.x, -render.camera.y, 0.f)));
 
 	LagrangianFluidSim::bind_ssbos(*system);
@@ -432,6 +432,7 @@ void TextureAtlas::write_to_png() {
 
 void TextureAtlas::load_to_gpu() {
 	texture->load_to_gpu(buffer.data);
+	texture->load_to_array(buffer.data);
 	arr_free(&ids);
 	arr_free(&rects);
 	arr_free(&nodes);
@@ -471,16 +472,114 @@ void Texture::load_to_gpu(u32* data) {
 	glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+void Texture::load_to_array(u32* data) {
+	if (!texture_arrays.enabled) return;
+
+	// A reloaded texture keeps its layer
+	if (!array) {
+		array = find_texture_array(width, height);
+		if (!array) return;
+
+		layer = array->add_layer();
+		if (layer < 0) {
+			array = nullptr;
+			return;
+		}
+	}
+
+	array->write_layer(layer, data);
+}
+
 void Texture::unload_from_gpu() {
 	glDeleteTextures(1, &handle);
 	handle = 0;
 }
 
 
+//
+// TEXTURE ARRAY
+//
+void TextureArray::init(i32 width, i32 height) {
+	this->width = width;
+	this->height = height;
+	this->num_layers = 0;
+	this->max_layers = 0;
+	this->handle = 0;
+	grow(initial_layers);
+}
+
+i32 TextureArray::add_layer() {
+	if (num_layers == max_layers) {
+		i32 limit = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &limit);
+		if (max_layers == limit) {
+			tdns_log.write("texture array (%d x %d) is full; texture will be drawn on its own", width, height);
+			return -1;
+		}
+
+		grow(std::min(max_layers * 2, limit));
+	}
+
+	return num_layers++;
+}
+
+void TextureArray::write_layer(i32 layer, u32* data) {
+	glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::grow(i32 max_layers) {
+	// Immutable storage can't be resized, so make a bigger array and copy the existing layers over
+	u32 old_handle = handle;
+
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, width, height, max_layers);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	if (old_handle) {
+		if (num_layers) {
+			glCopyImageSubData(old_handle, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+							   handle, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+							   width, height, num_layers);
+		}
+		glDeleteTextures(1, &old_handle);
+	}
+
+	this->max_layers = max_layers;
+
+	// The old name may have been cached as bound, and the driver is free to hand it out again
+	render.gl_cache.invalidate();
+}
+
+TextureArray* find_texture_array(i32 width, i32 height) {
+	arr_for(texture_arrays.arrays, array) {
+		if (array->width == width && array->height == height) return array;
+	}
+
+	if (texture_arrays.arrays.size == texture_arrays.arrays.capacity) return nullptr;
+
+	auto array = arr_push(&texture_arrays.arrays);
+	array->init(width, height);
+	return array;
+}
+
+void enable_texture_arrays() {
+	texture_arrays.enabled = true;
+}
+
+
 ///////////////
 // LIFECYCLE //
 ///////////////
 void init_texture_atlas() {
+	arr_init(&texture_arrays.arrays);
+
 	lua_State* l = get_lua().state;
 
 	// Push global texture data onto the stack
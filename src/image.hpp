@@ -1,3 +1,5 @@
+struct TextureArray;
+
 struct Texture {
 	hash_t hash;
 	u32 handle;
@@ -5,14 +7,47 @@ struct Texture {
 	i32 height;
 	i32 channels;
 
+	// Set when the texture was also copied into a texture array (see load_to_array())
+	TextureArray* array;
+	i32 layer;
+
 	void init(i32 width, i32 height, i32 channels);
 	void load_to_gpu(u32* data);
+	void load_to_array(u32* data);
 	void unload_from_gpu();
 };
 Texture* find_texture(const char* name);
 Texture* find_texture(hash_t hash);
 FM_LUA_EXPORT u32 find_texture_handle(const char* name);
 
+// Atlases and background tiles are all the same size, so they can share one GL_TEXTURE_2D_ARRAY per size. A
+// sprite's layer rides along in its vertices, which means draw calls don't have to be split whenever the sprite
+// comes from a different texture. Textures keep their own GL_TEXTURE_2D as well, for everything that samples
+// them directly (ImGui, particles, post processing).
+struct TextureArray {
+	static constexpr i32 initial_layers = 4;
+
+	u32 handle;
+	i32 width;
+	i32 height;
+	i32 num_layers;
+	i32 max_layers;
+
+	void init(i32 width, i32 height);
+	i32  add_layer();
+	void write_layer(i32 layer, u32* data);
+	void grow(i32 max_layers);
+};
+
+struct TextureArrays {
+	Array<TextureArray, 8> arrays;
+	bool enabled;
+};
+TextureArrays texture_arrays;
+
+TextureArray* find_texture_array(i32 width, i32 height);
+FM_LUA_EXPORT void enable_texture_arrays();
+
 struct Sprite {
 	char file_path [MAX_PATH_LEN];
 	hash_t hash;
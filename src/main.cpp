@@ -90,6 +90,9 @@ int main() {
 	init_paths();
 	init_log();
 	init_time();
+#ifdef FM_BENCHMARK
+	run_benchmarks();
+#endif
 	init_steam();
 	init_file_monitors();
 	init_assets();
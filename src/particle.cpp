@@ -18,6 +18,9 @@ ParticleSystemHandle make_particle_system() {
 			particle_system->generation++;
 			particle_system->init();
 
+			// Seed from the slot, so the same sequence of systems gets the same particles
+			particle_system->rng.seed(((u64)index << 32) | (u32)particle_system->generation);
+
 			handle.index = index;
 			handle.generation = particle_system->generation;
 			return handle;
@@ -40,7 +43,10 @@ ParticleSystemFrame check_particle_system(ParticleSystemHandle handle) {
 	auto particle_system = find_particle_system(handle);
 	if (!particle_system) return ParticleSystemFrame();
 	
-	return particle_system->frame_stats;
+	auto frame = particle_system->frame_stats;
+	frame.capacity = particle_system->particles.capacity;
+	frame.out_of_budget = particle_system->out_of_budget;
+	return frame;
 }
 
 void start_particle_emission(ParticleSystemHandle handle) {
@@ -61,9 +67,9 @@ void clear_particles(ParticleSystemHandle handle) {
 	auto particle_system = find_particle_system(handle);
 	if (!particle_system) return;
 
-	arr_for(particle_system->particles, particle) {
-		if (!particle->occupied) continue;
-		particle_system->despawn_particle(particle);
+	// Despawn from the back, so nothing gets swapped around
+	while (particle_system->num_alive) {
+		particle_system->despawn_particle(particle_system->num_alive - 1);
 	}
 }
 
@@ -72,31 +78,200 @@ void update_particles(ParticleSystemHandle handle) {
 	if (!particle_system) return;
 
 	particle_system->update();
+
+	if (particle_system->warmup_time) {
+		time_metrics["particle_warmup"].record(particle_system->warmup_time);
+		particle_system->warmup_time = 0;
+	}
+}
+
+void update_all_particles() {
+	auto& workers = particle_workers;
+
+	{
+		std::unique_lock lock(workers.mutex);
+		workers.num_jobs = 0;
+		arr_for(particle_systems, particle_system) {
+			if (!particle_system->occupied) continue;
+
+			assert(workers.num_jobs < PARTICLE_SYSTEMS_SIZE);
+			workers.jobs[workers.num_jobs++] = particle_system;
+		}
+		if (!workers.num_jobs) return;
+
+		workers.next_job = 0;
+		workers.num_finished = 0;
+		workers.num_acknowledged = 0;
+		workers.batch++;
+	}
+	workers.wake.notify_all();
+
+	workers.run_jobs();
+
+	// Wait for the last systems to finish, and for every worker to have picked up this batch and be done with it.
+	// Waiting on only the workers that happened to be awake isn't enough; one that wakes late would pull jobs from
+	// the list while the next frame rebuilds it.
+	std::unique_lock lock(workers.mutex);
+	workers.done.wait(lock, [&]() {
+		return workers.num_finished == workers.num_jobs && workers.num_acknowledged == workers.num_workers;
+	});
+
+	// Every system that warmed up this frame counts towards the same sample
+	float64 warmup_time = 0;
+	for (u32 i = 0; i < workers.num_jobs; i++) {
+		warmup_time += workers.jobs[i]->warmup_time;
+		workers.jobs[i]->warmup_time = 0;
+	}
+	if (warmup_time) time_metrics["particle_warmup"].record(warmup_time);
 }
 
 void draw_particles(ParticleSystemHandle handle) {
 	auto particle_system = find_particle_system(handle);
 	if (!particle_system) return;
+	if (!particle_system->num_alive) return;
+
+	// Shaders are created from Lua after the particle renderer is initialized, so look it up lazily
+	if (!particle_renderer.shader) particle_renderer.shader = gpu_shader_find("particle_instance");
+	if (!particle_renderer.shader) return;
+
+	// Kind and sprite belong to the whole system, so the system is one instanced draw call
+	auto kind = particle_system->particle_kind;
+	auto sprite = particle_system->image.sprite;
+	if (kind == ParticleKind::Invalid) return;
+	if (kind == ParticleKind::Image && !sprite) return;
+
+	set_active_shader_ex(particle_renderer.shader);
+	set_draw_primitive(DrawPrimitive::Triangles);
+	if (kind == ParticleKind::Image) {
+		auto texture = find_texture(sprite->texture);
+		set_uniform_texture("sampler", texture->handle);
+	}
+	set_uniform_i32("particle_kind", static_cast<i32>(kind));
+
+	// Sprite UVs are laid out like fm_quad(); the first vertex is the top left and the third is the bottom right
+	Vector4 uv;
+	if (kind == ParticleKind::Image) {
+		uv.x = sprite->uv[0].x;
+		uv.y = sprite->uv[0].y;
+		uv.z = sprite->uv[2].x;
+		uv.w = sprite->uv[2].y;
+	}
+	else {
+		uv.x = 0.f;
+		uv.y = 1.f;
+		uv.z = 1.f;
+		uv.w = 0.f;
+	}
 
-	arr_for(particle_system->particles, particle) {
-		if (!particle->occupied) continue;
+	// Particles that can't be seen are skipped, so only the ones that are kept are written; whatever was reserved for
+	// the rest is given back afterwards
+	auto command_buffer = render.pipeline->command_buffer;
+	auto cull = gpu_command_buffer_find_cull_rect(command_buffer);
+
+	auto batch = find_particle_batch(command_buffer);
+	if (!batch) return;
+
+	// Once the batch is full, the rest of the system isn't drawn this frame
+	u32 num_reserved = std::min((u32)particle_system->num_alive, gpu_instance_batch_find_room(batch));
+	if (!num_reserved) return;
+
+	auto& particles = particle_system->particles;
+	auto instances = (ParticleInstance*)gpu_command_buffer_alloc_instance_data(command_buffer, batch, num_reserved);
+	if (!instances) return;
+
+	u32 num_kept = 0;
+	u32 num_culled = 0;
+	for (i32 index = 0; index < particle_system->num_alive && num_kept < num_reserved; index++) {
+		// Circles are positioned by their center and sized by their radius; everything else is a top-left quad
+		Vector2 position;
+		Vector2 size;
+		if (kind == ParticleKind::Circle) {
+			auto radius = particles.size_x[index];
+			position = { particles.position_x[index] - radius, particles.position_y[index] + radius };
+			size = { 2 * radius, 2 * radius };
+		}
+		else {
+			position = { particles.position_x[index], particles.position_y[index] };
+			size = { particles.size_x[index], particles.size_y[index] };
+		}
 
-		// DRAW ONE PARTICLE
-		auto color = particle->color;
-		color.a *= particle_system->master_opacity;
-		if (particle->kind == ParticleKind::Quad) {
-			auto& quad = particle->data.quad;
-			draw_quad(particle->position, quad.size, color);
+		if (!cull.overlaps(Vector2(position.x, position.y - size.y), Vector2(position.x + size.x, position.y))) {
+			num_culled++;
+			continue;
 		}
-		else if (particle->kind == ParticleKind::Circle) {
-			auto& circle = particle->data.circle;
-			draw_circle(particle->position.x, particle->position.y, circle.radius, color);
+
+		auto instance = instances + num_kept;
+		num_kept++;
+
+		float opacity = particles.color_a[index] * particle_system->master_opacity;
+		if (kind == ParticleKind::Image) {
+			instance->color = pack_rgba8(1.f, 1.f, 1.f, opacity);
 		}
-		else if (particle->kind == ParticleKind::Image) {
-			auto& image = particle->data.image;
-			draw_image(image.sprite, particle->position.x, particle->position.y, image.size.x, image.size.y, color.a);
+		else {
+			instance->color = pack_rgba8(particles.color_r[index], particles.color_g[index], particles.color_b[index], opacity);
 		}
+
+		instance->position = position;
+		instance->size = size;
+		instance->uv = uv;
 	}
+
+	if (num_kept < num_reserved) gpu_command_buffer_trim_instance_data(command_buffer, batch, num_reserved - num_kept);
+	if (cull.enabled) gpu_command_buffer_count_culled(command_buffer, num_kept, num_culled);
+}
+
+GpuInstanceBatch* find_particle_batch(GpuCommandBufferBatched* command_buffer) {
+	arr_for(particle_renderer.batches, batch) {
+		if (batch->command_buffer == command_buffer) return batch->instances;
+	}
+
+	if (particle_renderer.batches.size == particle_renderer.batches.capacity) return nullptr;
+
+	VertexAttribute attributes [4];
+	attributes[0] = { 2, VertexAttributeKind::Float, 1 }; // Position
+	attributes[1] = { 2, VertexAttributeKind::Float, 1 }; // Size
+	attributes[2] = { 1, VertexAttributeKind::U32,   1 }; // Color
+	attributes[3] = { 4, VertexAttributeKind::Float, 1 }; // UV
+
+	GpuInstanceBatchDescriptor descriptor;
+	descriptor.instance_attributes = attributes;
+	descriptor.num_instance_attributes = 4;
+	descriptor.max_instances = ParticleRenderer::max_instances;
+	descriptor.vertices_per_instance = 6;
+
+	auto batch = arr_push(&particle_renderer.batches);
+	batch->command_buffer = command_buffer;
+	batch->instances = gpu_instance_batch_create(descriptor);
+	return batch->instances;
+}
+
+ParticlePoolStats check_particle_pool() {
+	auto stats = particle_pool.stats;
+	stats.bytes_budget = particle_pool.budget;
+	return stats;
+}
+
+void set_particle_budget(u32 bytes) {
+	particle_pool.budget = bytes;
+	if (particle_pool.stats.bytes_resident > bytes) particle_pool.trim();
+}
+
+void trim_particle_pool() {
+	particle_pool.trim();
+}
+
+void apply_particle_descriptor(ParticleSystemHandle handle, ParticleSystemDescriptor* descriptor) {
+	auto particle_system = find_particle_system(handle);
+	if (!particle_system) return;
+
+	particle_system->apply_descriptor(descriptor);
+}
+
+void read_particle_descriptor(ParticleSystemHandle handle, ParticleSystemDescriptor* descriptor) {
+	auto particle_system = find_particle_system(handle);
+	if (!particle_system) return;
+
+	particle_system->read_descriptor(descriptor);
 }
 
 void stop_all_particles() {
@@ -127,7 +302,14 @@ void set_particle_max_spawn(ParticleSystemHandle handle, int max_spawn) {
 	auto particle_system = find_particle_system(handle);
 	if (!particle_system) return;
 	
-	particle_system->max_spawn = std::min(max_spawn, ParticleSystem::max_particles);
+	particle_system->max_spawn = std::min(max_spawn, (int)ParticlePool::max_capacity);
+}
+
+void set_particle_capacity(ParticleSystemHandle handle, u32 capacity) {
+	auto particle_system = find_particle_system(handle);
+	if (!particle_system) return;
+
+	particle_system->resize(capacity);
 }
 
 void set_particle_size(ParticleSystemHandle handle, float x, float y) {
@@ -157,6 +339,7 @@ void set_particle_sprite(ParticleSystemHandle handle, const char* sprite) {
 
 	if (particle_system->particle_kind == ParticleKind::Image) {
 		particle_system->image.sprite = find_sprite(sprite);
+		particle_system->image.name = sprite ? hash_label(sprite) : 0;
 	}
 }
 
@@ -183,13 +366,14 @@ void set_particle_kind(ParticleSystemHandle handle, ParticleKind particle_kind)
 		particle_kind = ParticleKind::Invalid;
 	}
 	particle_system->particle_kind = particle_kind;
+	particle_system->select_kernels();
 }
 
 void set_particle_color(ParticleSystemHandle handle, float r, float g, float b, float a) {
 	auto particle_system = find_particle_system(handle);
 	if (!particle_system) return;
 
-	particle_system->color = Vector4(r, g, b, a);
+	particle_system->color = { r, g, b, a };
 }
 
 void set_particle_layer(ParticleSystemHandle handle, int32 layer) {
@@ -239,6 +423,7 @@ void set_particle_jitter_base_velocity(ParticleSystemHandle handle, bool jitter)
 	if (!particle_system) return;
 
 	particle_system->jitter_base_velocity = jitter;
+	particle_system->select_kernels();
 }
 
 void set_particle_jitter_max_velocity(ParticleSystemHandle handle, bool jitter) {
@@ -246,6 +431,7 @@ void set_particle_jitter_max_velocity(ParticleSystemHandle handle, bool jitter)
 	if (!particle_system) return;
 
 	particle_system->jitter_max_velocity = jitter;
+	particle_system->select_kernels();
 }
 
 void set_particle_size_jitter(ParticleSystemHandle handle, float jitter) {
@@ -260,6 +446,7 @@ void set_particle_jitter_size(ParticleSystemHandle handle, bool jitter) {
 	if (!particle_system) return;
 
 	particle_system->jitter_size = jitter;
+	particle_system->select_kernels();
 }
 
 void set_particle_master_opacity(ParticleSystemHandle handle, float opacity) {
@@ -281,6 +468,7 @@ void set_particle_jitter_opacity(ParticleSystemHandle handle, bool jitter) {
 	if (!particle_system) return;
 
 	particle_system->jitter_opacity = jitter;
+	particle_system->select_kernels();
 }
 
 void set_particle_opacity_interpolation(ParticleSystemHandle handle, bool active, float start_time, float interpolate_to) {
@@ -290,6 +478,7 @@ void set_particle_opacity_interpolation(ParticleSystemHandle handle, bool active
 	particle_system->opacity_interpolate_active = active;
 	particle_system->opacity_interpolate_time = start_time;
 	particle_system->opacity_interpolate_target = interpolate_to;
+	particle_system->select_kernels();
 }
 
 void set_particle_warm(ParticleSystemHandle handle, bool warm) {
@@ -307,6 +496,13 @@ void set_particle_warmup(ParticleSystemHandle handle, int32 iter) {
 	particle_system->warmup_iter = iter;
 }
 
+void set_particle_warmup_mode(ParticleSystemHandle handle, ParticleWarmupMode mode) {
+	auto particle_system = find_particle_system(handle);
+	if (!particle_system) return;
+
+	particle_system->warmup_mode = mode;
+}
+
 void set_particle_gravity_source(ParticleSystemHandle handle, float x, float y) {
 	auto particle_system = find_particle_system(handle);
 	if (!particle_system) return;
@@ -326,30 +522,203 @@ void set_particle_gravity_enabled(ParticleSystemHandle handle, bool enabled) {
 	if (!particle_system) return;
 
 	particle_system->gravity_enabled = enabled;
+	particle_system->select_kernels();
 }
 
 
+/////////////
+// KERNELS //
+/////////////
+// Ages every live particle and moves it. Velocity is evaluated from the particle's age: the interpolation
+// progress is just accumulated * speed, clamped to 1. Like Interpolator::get_value(), every function is
+// evaluated linearly.
+template<u32 features>
+void particle_update_kernel(ParticleSystem* particle_system, float dt) {
+	constexpr bool interpolate_opacity = features & ParticleFeatures::InterpolateOpacity;
+
+	if constexpr (features & ParticleFeatures::Gravity) {
+		particle_system->apply_gravity();
+	}
+
+	auto& p = particle_system->particles;
+	auto num_alive = particle_system->num_alive;
+	float speed = particle_system->velocity.speed;
+	float opacity_interpolate_time = particle_system->opacity_interpolate_time;
+	float opacity_interpolate_target = particle_system->opacity_interpolate_target;
+	
+	i32 index = 0;
+
+#if FM_SIMD
+	auto dt4 = _mm_set1_ps(dt);
+	auto speed4 = _mm_set1_ps(speed);
+	auto one = _mm_set1_ps(1.f);
+	auto zero = _mm_setzero_ps();
+	auto opacity_time = _mm_set1_ps(opacity_interpolate_time);
+	auto opacity_target = _mm_set1_ps(opacity_interpolate_target);
+
+	for (; index + 4 <= num_alive; index += 4) {
+		auto accumulated = _mm_add_ps(_mm_loadu_ps(p.accumulated + index), dt4);
+		_mm_storeu_ps(p.accumulated + index, accumulated);
+
+		auto progress = _mm_min_ps(_mm_mul_ps(accumulated, speed4), one);
+		auto remaining = _mm_sub_ps(one, progress);
+
+		auto velocity_x = _mm_add_ps(_mm_mul_ps(remaining, _mm_loadu_ps(p.velocity_start_x + index)), _mm_mul_ps(progress, _mm_loadu_ps(p.velocity_target_x + index)));
+		auto velocity_y = _mm_add_ps(_mm_mul_ps(remaining, _mm_loadu_ps(p.velocity_start_y + index)), _mm_mul_ps(progress, _mm_loadu_ps(p.velocity_target_y + index)));
+		_mm_storeu_ps(p.position_x + index, _mm_add_ps(_mm_loadu_ps(p.position_x + index), velocity_x));
+		_mm_storeu_ps(p.position_y + index, _mm_add_ps(_mm_loadu_ps(p.position_y + index), velocity_y));
+
+		if constexpr (interpolate_opacity) {
+			auto elapsed = _mm_sub_ps(accumulated, opacity_time);
+			auto duration = _mm_sub_ps(_mm_loadu_ps(p.lifetime + index), opacity_time);
+			auto t = _mm_div_ps(elapsed, duration);
+			auto opacity = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, t), _mm_loadu_ps(p.base_opacity + index)), _mm_mul_ps(t, opacity_target));
+
+			auto mask = _mm_cmpge_ps(elapsed, zero);
+			auto current = _mm_loadu_ps(p.color_a + index);
+			_mm_storeu_ps(p.color_a + index, _mm_or_ps(_mm_and_ps(mask, opacity), _mm_andnot_ps(mask, current)));
+		}
+	}
+#endif
+
+	for (; index < num_alive; index++) {
+		p.accumulated[index] += dt;
+
+		auto progress = std::min(p.accumulated[index] * speed, 1.f);
+		p.position_x[index] += interpolate_linear(p.velocity_start_x[index], p.velocity_target_x[index], progress);
+		p.position_y[index] += interpolate_linear(p.velocity_start_y[index], p.velocity_target_y[index], progress);
+
+		if constexpr (interpolate_opacity) {
+			auto elapsed = p.accumulated[index] - opacity_interpolate_time;
+			auto duration = p.lifetime[index] - opacity_interpolate_time;
+			auto opacity = interpolate_linear(p.base_opacity[index], opacity_interpolate_target, elapsed / duration);
+			p.color_a[index] = elapsed >= 0.f ? opacity : p.color_a[index];
+		}
+	}
+}
+
+template<ParticleKind kind, u32 features>
+bool particle_spawn_kernel(ParticleSystem* particle_system) {
+	auto& particles = particle_system->particles;
+	auto& rng = particle_system->rng;
+
+	if (!particle_system->emit) return false;
+	if ((u32)particle_system->num_alive >= particles.capacity) return false;
+
+	// INTERNAL DATA STRUCTURES
+	auto index = particle_system->num_alive;
+	particle_system->num_alive++;
+
+	particle_system->frame_stats.spawned++;
+
+	// PARTICLE DATA
+	static constexpr float lifetime_jitter = .05f;
+	auto lifetime = particle_system->lifetime;
+	particles.lifetime[index] = lifetime + rng.next_float(-1 * lifetime_jitter * lifetime, lifetime_jitter * lifetime);
+	particles.accumulated[index] = 0;
+	
+	auto position = particle_system->position;
+	if (particle_system->position_mode == ParticlePositionMode::Bottom) {
+		particles.position_x[index] = rng.next_float(position.x, position.x + particle_system->area.x);
+		particles.position_y[index] = position.y;
+	}
+	else {
+		particles.position_x[index] = position.x;
+		particles.position_y[index] = position.y;
+	}
+
+	auto velocity_jitter = particle_system->velocity_jitter;
+	auto velocity_start = particle_system->velocity.start;
+	auto velocity_target = particle_system->velocity.target;
+	if constexpr (features & ParticleFeatures::JitterBaseVelocity) {
+		velocity_start.x += rng.next_float(-1 * velocity_jitter.x, velocity_jitter.x);
+		velocity_start.y += rng.next_float(-1 * velocity_jitter.y, velocity_jitter.y);
+	}
+	if constexpr (features & ParticleFeatures::JitterMaxVelocity) {
+		velocity_target.x += rng.next_float(-1 * velocity_jitter.x, velocity_jitter.x);
+		velocity_target.y += rng.next_float(-1 * velocity_jitter.y, velocity_jitter.y);
+	}
+	particles.velocity_start_x[index] = velocity_start.x;
+	particles.velocity_start_y[index] = velocity_start.y;
+	particles.velocity_target_x[index] = velocity_target.x;
+	particles.velocity_target_y[index] = velocity_target.y;
+
+	auto size = Vector2();
+	if constexpr (kind == ParticleKind::Quad) {
+		size = particle_system->quad.size;
+	}
+	else if constexpr (kind == ParticleKind::Circle) {
+		size.x = particle_system->circle.radius;
+	}
+	else if constexpr (kind == ParticleKind::Image) {
+		size = particle_system->image.size;
+	}
+
+	if constexpr (features & ParticleFeatures::JitterSize) {
+		auto size_jitter = particle_system->size_jitter;
+		auto jitter = rng.next_float(-1 * size_jitter, size_jitter);
+		size.x += jitter;
+		if constexpr (kind != ParticleKind::Circle) size.y += jitter;
+	}
+	particles.size_x[index] = size.x;
+	particles.size_y[index] = size.y;
+
+	auto& color = particle_system->color;
+	auto opacity = color.a;
+	if constexpr (features & ParticleFeatures::JitterOpacity) {
+		auto opacity_jitter = particle_system->opacity_jitter;
+		auto jitter = rng.next_float(-1 * opacity_jitter, opacity_jitter);
+		opacity = std::min(opacity + jitter, 1.f);
+	}
+	particles.color_r[index] = color.r;
+	particles.color_g[index] = color.g;
+	particles.color_b[index] = color.b;
+	particles.color_a[index] = opacity;
+	particles.base_opacity[index] = opacity;
+
+	return true;
+}
+
+// One entry per combination of update features
+template<u32... features>
+constexpr std::array<ParticleUpdateKernel, sizeof...(features)> make_particle_update_kernels(std::integer_sequence<u32, features...>) {
+	return { &particle_update_kernel<features>... };
+}
+
+// One entry per (kind, spawn features) pair. The spawn features are shifted down to start at bit zero.
+template<u32... indices>
+constexpr std::array<ParticleSpawnKernel, sizeof...(indices)> make_particle_spawn_kernels(std::integer_sequence<u32, indices...>) {
+	constexpr u32 shift = 2;
+	constexpr u32 per_kind = (ParticleFeatures::Spawn >> shift) + 1;
+	return { &particle_spawn_kernel<static_cast<ParticleKind>(indices / per_kind), (indices % per_kind) << shift>... };
+}
+
+constexpr u32 particle_kind_count = static_cast<u32>(ParticleKind::Invalid) + 1;
+constexpr auto particle_update_kernels = make_particle_update_kernels(std::make_integer_sequence<u32, ParticleFeatures::Update + 1>());
+constexpr auto particle_spawn_kernels = make_particle_spawn_kernels(std::make_integer_sequence<u32, particle_kind_count * ((ParticleFeatures::Spawn >> 2) + 1)>());
+
+
 /////////////////////
 // PARTICLE SYSTEM //
 /////////////////////
 void ParticleSystem::init() {
 	// INTERNAL DATA STRUCTURES
-	arr_init(&particles, ParticleSystem::max_particles);
-	particles.size = ParticleSystem::max_particles;
-	
-	for (int index = 0; index < particles.size - 1; index++) {
-		particles[index]->next = particles[index + 1];
-	}
-	free_list = particles[0];
+	particles.init(ParticleSystem::default_capacity);
+	out_of_budget = !particles.capacity;
+
+	rng.seed(0);
 
 	// RESET TIMERS
-	num_spawned = 0;
+	num_alive = 0;
 	spawn_accumulated = 0.f;
+	warmup_time = 0;
 	warm = false;
 	emit = true;
 
 	// DEFAULT PARTICLE SYSTEM PARAMETERS
 	particle_kind = ParticleKind::Quad;
+	image.sprite = nullptr;
+	image.name = 0;
 	position_mode = ParticlePositionMode::Bottom;
 	position = Vector2(0.f, 0.f);
 	area = Vector2(100.f, 100.f);
@@ -362,6 +731,7 @@ void ParticleSystem::init() {
 	lifetime = 1.f;
 	layer = 31;
 	warmup_iter = 0; 
+	warmup_mode = ParticleWarmupMode::Simulate;
 	gravity_source = Vector2(0.f, 0.f); 
 	gravity_intensity = 1.f; 
 	gravity_enabled = false;
@@ -371,10 +741,17 @@ void ParticleSystem::init() {
 	opacity_interpolate_active = false;
 	opacity_interpolate_time = 0.f;
 	opacity_interpolate_target = 0.f;
+	velocity_jitter = Vector2(0.f, 0.f);
+	jitter_base_velocity = false;
+	jitter_max_velocity = false;
+	size_jitter = 0.f;
+	jitter_size = false;
+
+	select_kernels();
 }
 
 void ParticleSystem::deinit() {
-	arr_free(&particles);
+	particles.deinit();
 }
 
 void ParticleSystem::update() {
@@ -384,166 +761,498 @@ void ParticleSystem::update() {
 		spawn_accumulated += engine.dt;
 		auto spawn_target = 1.f / spawn_rate;
 
-		while (spawn_accumulated >= spawn_target && num_spawned < max_spawn) {
+		while (spawn_accumulated >= spawn_target && num_alive < max_spawn) {
 			spawn_accumulated -= spawn_target;
 			if (!spawn_particle()) break;
 		}
 
-		float max_gravity_distance = v2_length(v2_subtract(gravity_source, position));
-		float distance_threshold = 0.1f;
-		float alignment_threshold = 0.95f;
-		float deceleration = .99f;
-		
-		arr_for(particles, particle) {
-			if (!particle->occupied) continue;
+		integrate(engine.dt);
 
-			frame_stats.alive++;
+		frame_stats.alive += num_alive;
 
-			// UPDATE ONE PARTICLE
-			particle->accumulated += engine.dt;
-			if (particle->accumulated >= particle->lifetime) {
-				despawn_particle(particle);
+		// Despawning moves the last particle into this slot, so look at the same index again
+		i32 index = 0;
+		while (index < num_alive) {
+			if (particles.accumulated[index] >= particles.lifetime[index]) {
+				despawn_particle(index);
 			}
 			else {
-				if (gravity_enabled) {
-					auto direction = v2_subtract(gravity_source, particle->position);
-					auto direction_normal = v2_normal(direction);
-					
-					auto distance = v2_length(direction);
-					auto distance_ratio = std::min(distance / max_gravity_distance, 1.f);
-
-					// Base gravity
-					auto gravity_strength = gravity_intensity / 100.f;
-					gravity_strength *= distance_ratio; // Accelerate more the farther you are from the source
-					auto gravity = v2_scale(direction_normal, gravity_strength);
-
-					particle->velocity.target = v2_add(particle->velocity.target, gravity);
-
-					// Deceleration
-					auto velocity_normal = v2_normal(particle->velocity.target);
-					auto alignment = v2_dot(velocity_normal, direction_normal);
-					if (distance_ratio < distance_threshold || alignment < alignment_threshold) {
-						particle->velocity.target = v2_scale(particle->velocity.target, deceleration);
-					}
-				}
-
-				particle->velocity.update();
-				auto velocity = particle->velocity.get_value();
-				particle->position.x += velocity.x;
-				particle->position.y += velocity.y;
-
-				if (opacity_interpolate_active) {
-					auto accumulated = particle->accumulated - opacity_interpolate_time;
-					auto remaining = particle->lifetime - opacity_interpolate_time;
-					if (accumulated >= 0.f) {
-						particle->color.a = interpolate_linear(particle->base_color.a, opacity_interpolate_target, accumulated / remaining);
-					}
-				}
+				index++;
 			}
-		}	
+		}
 	};
 
 	if (!warm && warmup_iter) {
-		for (int i = 0; i < warmup_iter; i++) {
-			do_update();
+		auto time_begin = glfwGetTime();
+
+		if (warmup_mode == ParticleWarmupMode::Scatter) {
+			scatter();
+		}
+		else {
+			for (int i = 0; i < warmup_iter; i++) {
+				do_update();
+			}
 		}
+
+		warmup_time += glfwGetTime() - time_begin;
 	}
 	warm = true;
 
 	do_update();
 }
 
-bool ParticleSystem::spawn_particle() {
-	if (!emit) return false;
-	if (!free_list) return false;
+void ParticleSystem::apply_gravity() {
+	float max_gravity_distance = v2_length(v2_subtract(gravity_source, position));
+	float distance_threshold = 0.1f;
+	float alignment_threshold = 0.95f;
+	float deceleration = .99f;
 
-	// INTERNAL DATA STRUCTURES
-	auto particle = free_list;
-	free_list = free_list->next;
-	
-	num_spawned++;
+	for (i32 index = 0; index < num_alive; index++) {
+		auto particle_position = Vector2(particles.position_x[index], particles.position_y[index]);
+		auto direction = v2_subtract(gravity_source, particle_position);
+		auto direction_normal = v2_normal(direction);
+		
+		auto distance = v2_length(direction);
+		auto distance_ratio = std::min(distance / max_gravity_distance, 1.f);
+
+		// Base gravity
+		auto gravity_strength = gravity_intensity / 100.f;
+		gravity_strength *= distance_ratio; // Accelerate more the farther you are from the source
+		auto gravity = v2_scale(direction_normal, gravity_strength);
+
+		// Gravity pulls the velocity the particle is interpolating towards, so it still eases in with age
+		auto target = Vector2(particles.velocity_target_x[index], particles.velocity_target_y[index]);
+		target = v2_add(target, gravity);
+
+		// Deceleration
+		auto velocity_normal = v2_normal(target);
+		auto alignment = v2_dot(velocity_normal, direction_normal);
+		if (distance_ratio < distance_threshold || alignment < alignment_threshold) {
+			target = v2_scale(target, deceleration);
+		}
 
-	frame_stats.spawned++;
+		particles.velocity_target_x[index] = target.x;
+		particles.velocity_target_y[index] = target.y;
+	}
+}
 
-	// ARENA
-	particle->occupied = true;
+// Moves live particles into a block of a different size. If the new block is smaller, the particles that don't
+// fit are dropped.
+void ParticleSystem::resize(u32 capacity) {
+	capacity = ParticlePool::round_capacity(capacity);
+	if (capacity == particles.capacity) return;
 
-	// PARTICLE DATA
-	static constexpr float lifetime_jitter = .05f;
-	particle->lifetime = lifetime + random_float(-1 * lifetime_jitter * lifetime, lifetime_jitter * lifetime);
-	particle->accumulated = 0;
-	
-	if (position_mode == ParticlePositionMode::Bottom) {
-		particle->position.x = random_float(position.x, position.x + area.x);
-		particle->position.y = position.y;
-	}
-	else {
-		particle->position = position;
-	}
+	// If the pool is out of budget, keep the old streams rather than dropping every live particle
+	ParticleStreams resized;
+	resized.init(capacity);
+	out_of_budget = !resized.capacity;
+	if (out_of_budget) return;
 
-	particle->velocity = velocity;
-	
-	if (jitter_base_velocity) {
-		particle->velocity.start.x += random_float(-1 * velocity_jitter.x, velocity_jitter.x);
-		particle->velocity.start.y += random_float(-1 * velocity_jitter.y, velocity_jitter.y);
-	}
-	if (jitter_max_velocity) {
-		particle->velocity.target.x += random_float(-1 * velocity_jitter.x, velocity_jitter.x);
-		particle->velocity.target.y += random_float(-1 * velocity_jitter.y, velocity_jitter.y);
+	num_alive = std::min(num_alive, (int)resized.capacity);
+	resized.copy_from(&particles, num_alive);
+
+	particles.deinit();
+	particles = resized;
+}
+
+void ParticleSystem::apply_descriptor(ParticleSystemDescriptor* descriptor) {
+	// Most fields are plain copies. Only the ones that cost something to apply (the sprite lookup, resizing the
+	// streams, picking kernels) are compared against what the system already has.
+	auto& d = *descriptor;
+
+	// These are coming in from Lua, where you can type anything into the editor.
+	auto kind = d.particle_kind;
+	if (static_cast<int32>(kind) >= static_cast<int32>(ParticleKind::Invalid)) {
+		kind = ParticleKind::Invalid;
 	}
 
-	particle->kind = particle_kind;
+	bool reselect = kind != particle_kind
+		|| d.jitter_base_velocity != jitter_base_velocity
+		|| d.jitter_max_velocity != jitter_max_velocity
+		|| d.jitter_size != jitter_size
+		|| d.jitter_opacity != jitter_opacity
+		|| d.opacity_interpolate_active != opacity_interpolate_active
+		|| d.gravity_enabled != gravity_enabled;
+
+	particle_kind = kind;
 	if (particle_kind == ParticleKind::Quad) {
-		particle->data.quad = quad;
+		quad.size = d.size;
 	}
 	else if (particle_kind == ParticleKind::Circle) {
-		particle->data.circle = circle;
+		circle.radius = d.radius;
 	}
 	else if (particle_kind == ParticleKind::Image) {
-		particle->data.image = image;
-	}
+		image.size = d.size;
 
-	if (jitter_size) {
-		auto jitter = random_float(-1 * size_jitter, size_jitter);
-		if (particle_kind == ParticleKind::Quad) {
-			auto& size = particle->data.quad.size;
-			size.x += jitter;
-			size.y += jitter;
+		auto name = d.sprite ? hash_label(d.sprite) : 0;
+		if (!image.sprite || name != image.name) {
+			image.sprite = find_sprite(d.sprite);
+			image.name = name;
 		}
-		else if (particle_kind == ParticleKind::Circle) {
-			auto& radius = particle->data.circle.radius;
-			radius += jitter;
-		}
-		else if (particle_kind == ParticleKind::Image) {
-			auto& size = particle->data.image.size;
-			size.x += jitter;
-			size.y += jitter;
+	}
+
+	color = d.color;
+	position_mode = d.position_mode;
+	position = d.position;
+	area = d.area;
+	layer = d.layer;
+	max_spawn = std::min(d.max_spawn, (int)ParticlePool::max_capacity);
+	spawn_rate = d.spawn_rate;
+	lifetime = d.lifetime;
+	velocity.function = d.velocity_fn;
+	velocity.start = d.velocity_base;
+	velocity.target = d.velocity_max;
+	velocity_jitter = d.velocity_jitter;
+	jitter_base_velocity = d.jitter_base_velocity;
+	jitter_max_velocity = d.jitter_max_velocity;
+	size_jitter = d.size_jitter;
+	jitter_size = d.jitter_size;
+	master_opacity = d.master_opacity;
+	opacity_jitter = d.opacity_jitter;
+	jitter_opacity = d.jitter_opacity;
+	opacity_interpolate_active = d.opacity_interpolate_active;
+	opacity_interpolate_time = d.opacity_interpolate_time;
+	opacity_interpolate_target = d.opacity_interpolate_target;
+	warmup_iter = d.warmup_iter;
+	warmup_mode = d.warmup_mode;
+	gravity_source = d.gravity_source;
+	gravity_intensity = d.gravity_intensity;
+	gravity_enabled = d.gravity_enabled;
+
+	// resize() is a no-op for the same size class
+	if (d.capacity) resize(d.capacity);
+	if (reselect) select_kernels();
+}
+
+void ParticleSystem::read_descriptor(ParticleSystemDescriptor* descriptor) {
+	auto& d = *descriptor;
+
+	d.particle_kind = particle_kind;
+	d.size = particle_kind == ParticleKind::Image ? image.size : quad.size;
+	d.radius = circle.radius;
+	d.sprite = image.sprite ? image.sprite->file_path : nullptr;
+	d.color = color;
+	d.position_mode = position_mode;
+	d.position = position;
+	d.area = area;
+	d.layer = layer;
+	d.capacity = particles.capacity;
+	d.max_spawn = max_spawn;
+	d.spawn_rate = spawn_rate;
+	d.lifetime = lifetime;
+	d.velocity_fn = velocity.function;
+	d.velocity_base = velocity.start;
+	d.velocity_max = velocity.target;
+	d.velocity_jitter = velocity_jitter;
+	d.jitter_base_velocity = jitter_base_velocity;
+	d.jitter_max_velocity = jitter_max_velocity;
+	d.size_jitter = size_jitter;
+	d.jitter_size = jitter_size;
+	d.master_opacity = master_opacity;
+	d.opacity_jitter = opacity_jitter;
+	d.jitter_opacity = jitter_opacity;
+	d.opacity_interpolate_active = opacity_interpolate_active;
+	d.opacity_interpolate_time = opacity_interpolate_time;
+	d.opacity_interpolate_target = opacity_interpolate_target;
+	d.warmup_iter = warmup_iter;
+	d.warmup_mode = warmup_mode;
+	d.gravity_source = gravity_source;
+	d.gravity_intensity = gravity_intensity;
+	d.gravity_enabled = gravity_enabled;
+}
+
+void ParticleSystem::select_kernels() {
+	features = 0;
+	if (gravity_enabled)            features |= ParticleFeatures::Gravity;
+	if (opacity_interpolate_active) features |= ParticleFeatures::InterpolateOpacity;
+	if (jitter_base_velocity)       features |= ParticleFeatures::JitterBaseVelocity;
+	if (jitter_max_velocity)        features |= ParticleFeatures::JitterMaxVelocity;
+	if (jitter_size)                features |= ParticleFeatures::JitterSize;
+	if (jitter_opacity)             features |= ParticleFeatures::JitterOpacity;
+
+	update_kernel = particle_update_kernels[features & ParticleFeatures::Update];
+
+	auto kind_index = static_cast<u32>(particle_kind) * (particle_spawn_kernels.size() / particle_kind_count);
+	spawn_kernel = particle_spawn_kernels[kind_index + ((features & ParticleFeatures::Spawn) >> 2)];
+}
+
+void ParticleSystem::integrate(float dt) {
+	update_kernel(this, dt);
+}
+
+void ParticleSystem::scatter() {
+	// Particles spawn on a fixed interval, so after warmup_iter frames the live ones are spread evenly over the
+	// last lifetime seconds. If max_spawn caps the count, the same number are spread over the same window.
+	auto duration = std::min(warmup_iter * engine.dt, lifetime);
+	auto count = std::min(std::min((i32)(duration * spawn_rate), max_spawn), (i32)particles.capacity);
+	if (count <= 0) return;
+
+	auto interval = duration / count;
+	for (i32 i = 0; i < count; i++) {
+		if (!spawn_particle()) break;
+
+		auto index = num_alive - 1;
+		auto age = i * interval;
+		if (age >= particles.lifetime[index]) {
+			despawn_particle(index);
+			continue;
 		}
+
+		age_particle(index, age);
 	}
 
-	particle->base_color = color;
-	if (jitter_opacity) {
-		auto jitter = random_float(-1 * opacity_jitter, opacity_jitter);
-		particle->base_color.a = std::min(particle->base_color.a + jitter, 1.f);
+	spawn_accumulated = fmodf(warmup_iter * engine.dt, 1.f / spawn_rate);
+}
+
+void ParticleSystem::age_particle(i32 index, float age) {
+	// Position is stepped by the per-frame velocity once a frame, so the distance covered is the integral of the
+	// velocity ramp over the particle's age, divided by dt. The ramp reaches the target velocity at 1 / speed.
+	auto ramp = std::min(age, 1.f / velocity.speed);
+	auto distance = [&](float start, float target) {
+		auto slope = (target - start) * velocity.speed;
+		return (start * ramp + slope * ramp * ramp / 2.f + target * (age - ramp)) / engine.dt;
+	};
+
+	particles.accumulated[index] = age;
+	particles.position_x[index] += distance(particles.velocity_start_x[index], particles.velocity_target_x[index]);
+	particles.position_y[index] += distance(particles.velocity_start_y[index], particles.velocity_target_y[index]);
+
+	if (opacity_interpolate_active) {
+		auto elapsed = age - opacity_interpolate_time;
+		auto duration = particles.lifetime[index] - opacity_interpolate_time;
+		if (elapsed >= 0.f) {
+			particles.color_a[index] = interpolate_linear(particles.base_opacity[index], opacity_interpolate_target, elapsed / duration);
+		}
 	}
-	particle->color = particle->base_color;
+}
 
-	return true;
+bool ParticleSystem::spawn_particle() {
+	return spawn_kernel(this);
 }
 
-void ParticleSystem::despawn_particle(Particle* particle) {
-	if (!particle) return;
+void ParticleSystem::despawn_particle(i32 index) {
+	if (index < 0) return;
+	if (index >= num_alive) return;
 
 	// INTERNAL DATA STRUCTURES
-	particle->next = free_list;
-	free_list = particle;
-	
-	num_spawned--;
+	num_alive--;
+	if (index != num_alive) {
+		particles.move(index, num_alive);
+	}
 
 	frame_stats.despawned++;
+}
+
+
+//////////////////////
+// PARTICLE STREAMS //
+//////////////////////
+void ParticleStreams::init(u32 capacity) {
+	// Every stream lives in one block. Each one starts on a 16 byte boundary as long as the capacity is a
+	// multiple of four, which every pool size is.
+	capacity = ParticlePool::round_capacity(capacity);
+	memory = particle_pool.alloc(capacity);
+
+	// If the pool is over budget, the system just can't hold any particles
+	if (!memory) capacity = 0;
+	this->capacity = capacity;
+
+	auto streams = (float*)memory;
+	position_x        = streams + (capacity * 0);
+	position_y        = streams + (capacity * 1);
+	velocity_start_x  = streams + (capacity * 2);
+	velocity_start_y  = streams + (capacity * 3);
+	velocity_target_x = streams + (capacity * 4);
+	velocity_target_y = streams + (capacity * 5);
+	lifetime          = streams + (capacity * 6);
+	accumulated       = streams + (capacity * 7);
+	color_r           = streams + (capacity * 8);
+	color_g           = streams + (capacity * 9);
+	color_b           = streams + (capacity * 10);
+	color_a           = streams + (capacity * 11);
+	base_opacity      = streams + (capacity * 12);
+	size_x            = streams + (capacity * 13);
+	size_y            = streams + (capacity * 14);
+}
+
+void ParticleStreams::move(i32 destination, i32 source) {
+	position_x[destination]        = position_x[source];
+	position_y[destination]        = position_y[source];
+	velocity_start_x[destination]  = velocity_start_x[source];
+	velocity_start_y[destination]  = velocity_start_y[source];
+	velocity_target_x[destination] = velocity_target_x[source];
+	velocity_target_y[destination] = velocity_target_y[source];
+	lifetime[destination]          = lifetime[source];
+	accumulated[destination]       = accumulated[source];
+	color_r[destination]           = color_r[source];
+	color_g[destination]           = color_g[source];
+	color_b[destination]           = color_b[source];
+	color_a[destination]           = color_a[source];
+	base_opacity[destination]      = base_opacity[source];
+	size_x[destination]            = size_x[source];
+	size_y[destination]            = size_y[source];
+}
+
+void ParticleStreams::copy_from(ParticleStreams* other, u32 count) {
+	auto source = (float*)other->memory;
+	auto destination = (float*)memory;
+	if (!source || !destination) return;
+
+	for (u32 i = 0; i < num_float_streams; i++) {
+		copy_memory(source + (other->capacity * i), destination + (capacity * i), count * sizeof(float));
+	}
+}
+
+void ParticleStreams::deinit() {
+	particle_pool.free(memory, capacity);
+	memory = nullptr;
+	capacity = 0;
+}
+
+
+///////////////////
+// PARTICLE POOL //
+///////////////////
+u32 ParticlePool::round_capacity(u32 capacity) {
+	u32 rounded = min_capacity;
+	while (rounded < capacity && rounded < max_capacity) rounded *= 2;
+	return rounded;
+}
+
+u32 ParticlePool::size_class(u32 capacity) {
+	u32 index = 0;
+	while ((min_capacity << index) < capacity) index++;
+	return index;
+}
+
+u32 ParticlePool::block_size(u32 capacity) {
+	return ParticleStreams::num_float_streams * capacity * sizeof(float);
+}
+
+u8* ParticlePool::alloc(u32 capacity) {
+	auto index = size_class(capacity);
+	auto size = block_size(capacity);
+
+	// Free blocks store the next free block in their first bytes
+	if (free_lists[index]) {
+		auto block = free_lists[index];
+		free_lists[index] = *(u8**)block;
+
+		stats.reuses++;
+		stats.blocks_cached--;
+		stats.blocks_in_use++;
+		stats.bytes_in_use += size;
+		return block;
+	}
+
+	// Cached blocks of other sizes are the first thing to go if a new block doesn't fit
+	if (stats.bytes_resident + size > budget) trim();
+	if (stats.bytes_resident + size > budget) {
+		tdns_log.write("%s: particle pool is over budget; budget = %d, resident = %d, requested = %d", __func__, budget, stats.bytes_resident, size);
+		stats.failures++;
+		return nullptr;
+	}
+
+	stats.allocations++;
+	stats.blocks_in_use++;
+	stats.bytes_in_use += size;
+	stats.bytes_resident += size;
+	return standard_allocator.alloc<u8>(size);
+}
+
+void ParticlePool::free(u8* block, u32 capacity) {
+	if (!block) return;
+
+	auto index = size_class(capacity);
+	*(u8**)block = free_lists[index];
+	free_lists[index] = block;
+
+	stats.blocks_in_use--;
+	stats.blocks_cached++;
+	stats.bytes_in_use -= block_size(capacity);
+}
+
+void ParticlePool::trim() {
+	for (u32 index = 0; index < num_size_classes; index++) {
+		auto size = block_size(min_capacity << index);
+		while (free_lists[index]) {
+			auto block = free_lists[index];
+			free_lists[index] = *(u8**)block;
+			standard_allocator.free(block);
+
+			stats.blocks_cached--;
+			stats.bytes_resident -= size;
+		}
+	}
+}
+
+
+/////////
+// RNG //
+/////////
+void ParticleRng::seed(u64 value) {
+	state = 0;
+	next();
+	state += value;
+	next();
+}
+
+u32 ParticleRng::next() {
+	u64 previous = state;
+	state = previous * 6364136223846793005ULL + 1442695040888963407ULL;
 
-	// ARENA
-	particle->occupied = false;
+	u32 xorshifted = (u32)(((previous >> 18) ^ previous) >> 27);
+	u32 rotation = (u32)(previous >> 59);
+	return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+}
+
+float ParticleRng::next_float(float min, float max) {
+	// The top 24 bits fit exactly in a float's mantissa
+	float t = (next() >> 8) * (1.f / 16777216.f);
+	return min + (max - min) * t;
+}
+
+
+/////////////
+// WORKERS //
+/////////////
+void ParticleWorkers::process() {
+	u32 last_batch = 0;
+
+	while (true) {
+		{
+			std::unique_lock lock(mutex);
+			wake.wait(lock, [&]() { return batch != last_batch; });
+			last_batch = batch;
+		}
+
+		run_jobs();
+
+		{
+			std::unique_lock lock(mutex);
+			num_acknowledged++;
+		}
+		done.notify_one();
+	}
+}
+
+void ParticleWorkers::run_jobs() {
+	u32 completed = 0;
+	while (true) {
+		auto job = next_job.fetch_add(1);
+		if (job >= num_jobs) break;
+
+		jobs[job]->update();
+		completed++;
+	}
+
+	if (!completed) return;
+
+	{
+		std::unique_lock lock(mutex);
+		num_finished += completed;
+	}
+	done.notify_one();
 }
 
 
@@ -552,6 +1261,23 @@ void ParticleSystem::despawn_particle(Particle* particle) {
 //////////////////
 void init_particles() {
 	particle_systems.size = particle_systems.capacity;
+
+	tm_add("particle_warmup");
+
+	arr_init(&particle_renderer.batches);
+	particle_renderer.shader = nullptr;
+
+	// Leave a core for the main thread, which also updates systems
+	auto& workers = particle_workers;
+	workers.num_workers = std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, ParticleWorkers::max_workers);
+	workers.num_jobs = 0;
+	workers.num_finished = 0;
+	workers.num_acknowledged = 0;
+	workers.batch = 0;
+	for (u32 i = 0; i < workers.num_workers; i++) {
+		workers.threads[i] = std::thread(&ParticleWorkers::process, &workers);
+		workers.threads[i].detach();
+	}
 }
 
 ParticleSystem* find_particle_system(ParticleSystemHandle handle) {
@@ -1,3 +1,7 @@
+// Lives here rather than in buffers.hpp, which comes after this header, so the pool budget and the worker job list
+// can be sized by it
+#define PARTICLE_SYSTEMS_SIZE 64
+
 enum class ParticleKind : i32 {
 	Quad,
 	Circle,
@@ -15,52 +19,183 @@ struct ParticleCircle {
 
 struct ParticleImage {
 	Sprite* sprite;
+	hash_t name; // The sprite that was asked for, which may not be the one we found
 	Vector2 size;
 };
 
-union ParticleData {
-	ParticleQuad quad;
-	ParticleCircle circle;
-	ParticleImage image;
+// Particles are stored as parallel streams instead of an array of structs. The update loop only touches
+// the streams it actually needs, and the integration kernel can process four particles per iteration.
+//
+// A particle's interpolated velocity is a pure function of its age, so it isn't stored; each particle only
+// keeps its jittered start and target velocity.
+//
+// Live particles are always packed into [0, num_alive); despawning swaps the last live particle into the
+// freed slot. Nothing outside the system holds on to individual particles, so there's no handle indirection.
+struct ParticleStreams {
+	static constexpr u32 num_float_streams = 15;
+
+	u32 capacity;
+
+	float* position_x;
+	float* position_y;
+	float* velocity_start_x;
+	float* velocity_start_y;
+	float* velocity_target_x;
+	float* velocity_target_y;
+	float* lifetime;
+	float* accumulated;
+	float* color_r;
+	float* color_g;
+	float* color_b;
+	float* color_a;
+	float* base_opacity;
+	float* size_x; // Radius, for circles
+	float* size_y;
+
+	u8* memory;
+
+	void init(u32 capacity);
+	void deinit();
+	void move(i32 destination, i32 source);
+	void copy_from(ParticleStreams* other, u32 count);
 };
 
-struct Particle {
-	Vector2 position;
-	Interpolator2 velocity;
+// Stream blocks are recycled between systems instead of going back to the allocator, since the editor and scene
+// reloads create and free systems constantly. Capacities are rounded up to a power of two, and each size has its
+// own free list. Everything the pool holds, in use or not, counts against the budget.
+struct ParticlePoolStats {
+	u32 bytes_budget;
+	u32 bytes_resident;
+	u32 bytes_in_use;
+	u32 blocks_in_use;
+	u32 blocks_cached;
+	u32 allocations;
+	u32 reuses;
+	u32 failures;
+};
 
-	float lifetime;
-	float accumulated;
+struct ParticlePool {
+	static constexpr u32 min_capacity = 64;
+	static constexpr u32 max_capacity = 4096;
+	static constexpr u32 num_size_classes = 7;
+	static constexpr u32 default_budget = PARTICLE_SYSTEMS_SIZE * ParticleStreams::num_float_streams * max_capacity * sizeof(float); // Every system at max_capacity
 
-	ParticleKind kind;
-	ParticleData data;
-	Vector4 base_color;
-	Vector4 color;
+	u8* free_lists [num_size_classes];
+	u32 budget = default_budget;
+	ParticlePoolStats stats;
 
-	bool occupied = false;
-	Particle* next = nullptr;
+	u8* alloc(u32 capacity);
+	void free(u8* block, u32 capacity);
+	void trim();
+
+	static u32 round_capacity(u32 capacity);
+	static u32 size_class(u32 capacity);
+	static u32 block_size(u32 capacity);
 };
+ParticlePool particle_pool;
 
 enum class ParticlePositionMode {
 	Bottom,
 };
 
+// Warmup fills a new (or reset) system so it doesn't start empty on screen. Simulate runs the normal update
+// warmup_iter times in one frame. Scatter spawns the particles that would still be alive after that many frames
+// directly, at evenly spaced ages, and moves them to where they'd be in closed form. Gravity isn't applied to
+// scattered particles.
+enum class ParticleWarmupMode : i32 {
+	Simulate,
+	Scatter,
+};
+
 struct ParticleSystemFrame {
 	int spawned;
 	int despawned;
 	int alive;
+	u32 capacity;
+	bool out_of_budget; // The pool couldn't fit the capacity the system last asked for
+};
+
+// Every system gets its own RNG stream, so updating systems on different threads (in any order) gives the
+// same results as updating them one at a time. This is PCG32.
+struct ParticleRng {
+	u64 state;
+
+	void seed(u64 value);
+	u32 next();
+	float next_float(float min, float max);
+};
+
+// The settings that change what the update and spawn loops do are collected into a bitmask. Each combination
+// gets its own instantiation of the kernels, so the loops themselves have no per-particle branches on them.
+namespace ParticleFeatures {
+	constexpr u32 Gravity            = 1 << 0;
+	constexpr u32 InterpolateOpacity = 1 << 1;
+	constexpr u32 JitterBaseVelocity = 1 << 2;
+	constexpr u32 JitterMaxVelocity  = 1 << 3;
+	constexpr u32 JitterSize         = 1 << 4;
+	constexpr u32 JitterOpacity      = 1 << 5;
+
+	constexpr u32 Update = Gravity | InterpolateOpacity;
+	constexpr u32 Spawn = JitterBaseVelocity | JitterMaxVelocity | JitterSize | JitterOpacity;
+};
+
+// Every parameter a script can set, so that a system can be configured in one call instead of one call per field.
+// Size applies to quads and images, radius to circles, and sprite to images.
+struct ParticleSystemDescriptor {
+	ParticleKind particle_kind;
+	Vector2 size;
+	float radius;
+	const char* sprite;
+	Vector4 color;
+	ParticlePositionMode position_mode;
+	Vector2 position;
+	Vector2 area;
+	int32 layer;
+	u32 capacity;
+	int max_spawn;
+	float spawn_rate;
+	float lifetime;
+	InterpolationFn velocity_fn;
+	Vector2 velocity_base;
+	Vector2 velocity_max;
+	Vector2 velocity_jitter;
+	bool jitter_base_velocity;
+	bool jitter_max_velocity;
+	float size_jitter;
+	bool jitter_size;
+	float master_opacity;
+	float opacity_jitter;
+	bool jitter_opacity;
+	bool opacity_interpolate_active;
+	float opacity_interpolate_time;
+	float opacity_interpolate_target;
+	int32 warmup_iter;
+	ParticleWarmupMode warmup_mode;
+	Vector2 gravity_source;
+	float gravity_intensity;
+	bool gravity_enabled;
 };
 
+struct ParticleSystem;
+using ParticleUpdateKernel = void (*)(ParticleSystem* particle_system, float dt);
+using ParticleSpawnKernel  = bool (*)(ParticleSystem* particle_system);
+
 struct ParticleSystem {
 	bool occupied;
 	int32 generation;
 
-	static constexpr int max_particles = 4096;
-	Array<Particle> particles;
-	Particle* free_list;
+	static constexpr u32 default_capacity = ParticlePool::max_capacity;
+	ParticleStreams particles;
+	bool out_of_budget;
 
 	// RUNTIME
+	u32 features;
+	ParticleUpdateKernel update_kernel;
+	ParticleSpawnKernel spawn_kernel;
+	ParticleRng rng;
 	ParticleSystemFrame frame_stats;
-	int num_spawned;
+	float64 warmup_time; // Reported to time_metrics from the main thread, since warmup runs on the workers
+	int num_alive;
 	float spawn_accumulated;
 	bool warm;
 	bool emit;
@@ -83,6 +218,7 @@ struct ParticleSystem {
 	float spawn_rate;
 	float lifetime;
 	int warmup_iter;
+	ParticleWarmupMode warmup_mode;
 	Vector2 gravity_source;
 	float gravity_intensity;
 	bool gravity_enabled;
@@ -98,7 +234,15 @@ struct ParticleSystem {
 	void init();
 	void deinit();
 	void update();
-	void despawn_particle(Particle* particle);
+	void resize(u32 capacity);
+	void apply_descriptor(ParticleSystemDescriptor* descriptor);
+	void read_descriptor(ParticleSystemDescriptor* descriptor);
+	void select_kernels();
+	void apply_gravity();
+	void integrate(float dt);
+	void scatter();
+	void age_particle(i32 index, float age);
+	void despawn_particle(i32 index);
 	bool spawn_particle();
 };
 
@@ -109,9 +253,56 @@ struct ParticleSystemHandle {
 	operator bool();
 };
 
+// Particles are drawn as one instanced draw call per system. Each instance is expanded into a quad in particle_instance.vertex.
+struct ParticleInstance {
+	Vector2 position; // Top left, same as draw_quad()
+	Vector2 size;
+	u32 color;        // RGBA8, unpacked with unpackUnorm4x8()
+	Vector4 uv;       // Left, top, right, bottom
+};
+
+// Instance data is cleared when a command buffer renders, so every command buffer that draws particles gets its own
+// batch, the same as SDF shapes
+struct ParticleBatch {
+	GpuCommandBufferBatched* command_buffer;
+	GpuInstanceBatch* instances;
+};
+
+struct ParticleRenderer {
+	Array<ParticleBatch, 16> batches;
+	GpuShader* shader;
+
+	static constexpr u32 max_instances = 64 * 1024;
+};
+ParticleRenderer particle_renderer;
+
+// Systems don't share anything, so update_all_particles() hands them out to a pool of workers one system at a
+// time. The main thread pulls systems too, and returns once every system has been updated.
+struct ParticleWorkers {
+	static constexpr u32 max_workers = 16;
+	std::thread threads [max_workers];
+	u32 num_workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	ParticleSystem* jobs [PARTICLE_SYSTEMS_SIZE];
+	u32 num_jobs;
+	std::atomic<u32> next_job;
+	u32 num_finished;
+	u32 num_acknowledged; // Workers that are done with the current batch, and won't touch the job list until the next
+	u32 batch;
+
+	void process();
+	void run_jobs();
+};
+ParticleWorkers particle_workers;
+
 void init_particles();
 
 ParticleSystem* find_particle_system(ParticleSystemHandle handle);
+GpuInstanceBatch* find_particle_batch(GpuCommandBufferBatched* command_buffer);
 FM_LUA_EXPORT ParticleSystemHandle make_particle_system();
 FM_LUA_EXPORT void free_particle_system(ParticleSystemHandle handle);
 FM_LUA_EXPORT ParticleSystemFrame check_particle_system(ParticleSystemHandle handle);
@@ -119,11 +310,18 @@ FM_LUA_EXPORT void stop_particle_emission(ParticleSystemHandle handle);
 FM_LUA_EXPORT void start_particle_emission(ParticleSystemHandle handle);
 FM_LUA_EXPORT void clear_particles(ParticleSystemHandle handle);
 FM_LUA_EXPORT void update_particles(ParticleSystemHandle handle);
+FM_LUA_EXPORT void update_all_particles();
 FM_LUA_EXPORT void draw_particles(ParticleSystemHandle handle);
 FM_LUA_EXPORT void stop_all_particles();
+FM_LUA_EXPORT ParticlePoolStats check_particle_pool();
+FM_LUA_EXPORT void set_particle_budget(u32 bytes);
+FM_LUA_EXPORT void trim_particle_pool();
+FM_LUA_EXPORT void apply_particle_descriptor(ParticleSystemHandle handle, ParticleSystemDescriptor* descriptor);
+FM_LUA_EXPORT void read_particle_descriptor(ParticleSystemHandle handle, ParticleSystemDescriptor* descriptor);
 
 FM_LUA_EXPORT void set_particle_lifetime(ParticleSystemHandle handle, float lifetime);
 FM_LUA_EXPORT void set_particle_max_spawn(ParticleSystemHandle handle, int max_spawn);
+FM_LUA_EXPORT void set_particle_capacity(ParticleSystemHandle handle, u32 capacity);
 FM_LUA_EXPORT void set_particle_spawn_rate(ParticleSystemHandle handle, float spawn_rate);
 FM_LUA_EXPORT void set_particle_size(ParticleSystemHandle handle, float x, float y);
 FM_LUA_EXPORT void set_particle_radius(ParticleSystemHandle handle, float r);
@@ -148,6 +346,7 @@ FM_LUA_EXPORT void set_particle_jitter_opacity(ParticleSystemHandle handle, bool
 FM_LUA_EXPORT void set_particle_opacity_interpolation(ParticleSystemHandle handle, bool active, float start_time, float interpolate_to);
 FM_LUA_EXPORT void set_particle_warm(ParticleSystemHandle handle, bool warm);
 FM_LUA_EXPORT void set_particle_warmup(ParticleSystemHandle handle, int32 iter);
+FM_LUA_EXPORT void set_particle_warmup_mode(ParticleSystemHandle handle, ParticleWarmupMode mode);
 FM_LUA_EXPORT void set_particle_gravity_source(ParticleSystemHandle handle, float x, float y);
 FM_LUA_EXPORT void set_particle_gravity_intensity(ParticleSystemHandle handle, float intensity);
 FM_LUA_EXPORT void set_particle_gravity_enabled(ParticleSystemHandle handle, bool enabled);
@@ -71,6 +71,7 @@ void GpuShader::init_graphics(const char* name) {
 void GpuShader::init_graphics_ex(const char* name, const char* vertex_shader, const char* fragment_shader) {
 	kind = GpuShader::Kind::Graphics;
 	this->name = copy_string(name);
+	this->hash = hash_label(name);
 	this->vertex_path = copy_string(vertex_shader);
 	this->fragment_path = copy_string(fragment_shader);
 	
@@ -111,7 +112,7 @@ void GpuShader::init_graphics_ex(const char* name, const char* vertex_shader, co
 
 	// Push the data into the shader. If anything fails, the shader won't get the new GL handles
 	program = shader_program;
-	glGetProgramiv(shader_program, GL_ACTIVE_UNIFORMS, (int*)&num_uniforms);
+	reflect_uniforms();
 
 	set_gl_name(static_cast<u32>(GlId::Program), program, strlen(name), name);
 }
@@ -123,6 +124,7 @@ void GpuShader::init_compute(const char* name) {
 void GpuShader::init_compute_ex(const char* name, const char* compute_path) {
 	this->kind = GpuShader::Kind::Compute;
 	this->name = copy_string(name);
+	this->hash = hash_label(name);
 	this->compute_path = copy_string(compute_path);
 	auto source = build_shader_source(this->compute_path);
 	
@@ -136,6 +138,7 @@ void GpuShader::init_compute_ex(const char* name, const char* compute_path) {
 	glAttachShader(this->program, this->compute);
 	glLinkProgram(this->program);
 	check_shader_linkage(this->program, vertex_path);
+	reflect_uniforms();
 }
 
 void GpuShader::reload() {
@@ -143,6 +146,9 @@ void GpuShader::reload() {
 
 	glDeleteProgram(program);
 
+	// The new program may well get the same name, so the cache can't tell that it isn't bound yet
+	render.gl_cache.invalidate();
+
 	if (kind == GpuShader::Kind::Graphics) {
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -156,46 +162,110 @@ void GpuShader::reload() {
 	}
 }
 
+void GpuShader::reflect_uniforms() {
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, (int*)&num_uniforms);
+	if (num_uniforms > max_uniforms) {
+		tdns_log.write("%s: shader has more uniforms than we cache; shader = %s, uniforms = %d", __func__, name, num_uniforms);
+	}
+
+	for (u32 index = 0; index < std::min(num_uniforms, max_uniforms); index++) {
+		char uniform_name [Uniform::max_name_len];
+		i32 size;
+		u32 type;
+		glGetActiveUniform(program, index, Uniform::max_name_len, nullptr, &size, &type, uniform_name);
+
+		// Arrays are reported as their first element, but they're set by the name of the array
+		auto bracket = strstr(uniform_name, "[0]");
+		if (bracket && !bracket[3]) *bracket = 0;
+
+		auto& uniform_location = uniform_locations[index];
+		uniform_location.id = hash_label(uniform_name);
+		uniform_location.location = glGetUniformLocation(program, uniform_name);
+
+		// A relinked program starts over with default values
+		uniform_values[index] = Uniform();
+		uniform_values[index].kind = UniformKind::None;
+	}
+}
+
+i32 GpuShader::find_uniform_slot(UniformId id) {
+	auto num_cached = std::min(num_uniforms, max_uniforms);
+	for (u32 index = 0; index < num_cached; index++) {
+		if (uniform_locations[index].id == id) return index;
+	}
+
+	return -1;
+}
+
+i32 GpuShader::find_uniform_location(UniformId id, const char* name) {
+	auto slot = find_uniform_slot(id);
+	if (slot >= 0) return uniform_locations[slot].location;
+
+	auto num_cached = std::min(num_uniforms, max_uniforms);
+
+	// Other elements of an array (or of an array of structs) aren't cached, so those still go to the driver.
+	// Anything else that isn't cached isn't used by this shader.
+	if (!name) name = find_uniform_name(id);
+	if (!name) return -1;
+	if (num_cached < num_uniforms || strchr(name, '[')) return glGetUniformLocation(program, name);
+	return -1;
+}
+
 
 /////////////
 // UNIFORM //
 /////////////
+UniformId intern_uniform(const char* name) {
+	auto id = hash_label(name);
+	if (!uniform_names.contains(id)) {
+		uniform_names[id] = copy_string(name);
+	}
+
+	return id;
+}
+
+const char* find_uniform_name(UniformId id) {
+	auto it = uniform_names.find(id);
+	if (it == uniform_names.end()) return nullptr;
+	return it->second;
+}
+
 Uniform::Uniform() : kind(UniformKind::I32), as_i32(0) {}
 Uniform::Uniform(const char* name) : kind(UniformKind::I32), as_i32(0) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, const HMM_Mat4& m) : kind(UniformKind::Matrix4), mat4(m) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, const HMM_Mat3& m) : kind(UniformKind::Matrix3), mat3(m) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, const HMM_Vec4& v) : kind(UniformKind::Vector4), vec4(v) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, const HMM_Vec3& v) : kind(UniformKind::Vector3), vec3(v) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, const Vector2& v) : kind(UniformKind::Vector2), vec2(v) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, int32 i) : kind(UniformKind::I32), as_i32(i) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 Uniform::Uniform(const char* name, float32 f) : kind(UniformKind::F32), f32(f) {
-	strncpy(this->name, name, max_name_len);
+	this->id = intern_uniform(name);
 }
 
-bool are_uniforms_equal(Uniform& a, Uniform& b) {
+bool are_uniforms_equal(const Uniform& a, const Uniform& b) {
 	if (a.kind != b.kind) return false;
-	if (std::strncmp(a.name, b.name, Uniform::max_name_len) != 0) return false;
+	if (a.id != b.id) return false;
 
 	// Then, compare the union members based on `kind`
 	switch (a.kind) {
 		case UniformKind::Matrix4:
 			return !std::memcmp(&a.mat4, &b.mat4, sizeof(HMM_Mat4));
 		case UniformKind::Matrix3:
-			return std::memcmp(&a.mat3, &b.mat3, sizeof(HMM_Mat3));
+			return !std::memcmp(&a.mat3, &b.mat3, sizeof(HMM_Mat3));
 		case UniformKind::Vector4:
 			return a.vec4 == b.vec4;
 		case UniformKind::Vector3:
@@ -207,6 +277,7 @@ bool are_uniforms_equal(Uniform& a, Uniform& b) {
 		case UniformKind::F32:
 			return a.f32 == b.f32;
 		case UniformKind::Texture:
+		case UniformKind::TextureArray:
 			return a.texture == b.texture;
 		default:
 			return true;
@@ -13,14 +13,26 @@ enum class UniformKind : u32 {
 	Texture = 100,
 	PipelineOutput = 101,
 	RenderTarget = 102,
+	TextureArray = 103,
 };
 
 
+// Uniforms are identified by the hash of their name, which is computed once when the uniform is made. Shaders
+// look up their cached locations by this id instead of asking the driver by string.
+typedef hash_t UniformId;
+
+// Names are interned the first time they're seen, so a Uniform only has to carry its id. The name is only needed
+// again if the driver has to be asked for a location by string.
+std::unordered_map<UniformId, const char*> uniform_names;
+
+UniformId   intern_uniform(const char* name);
+const char* find_uniform_name(UniformId id);
+
 struct Uniform {
 	UniformKind kind = UniformKind::None;
 
 	static constexpr u32 max_name_len = 64;
-	char name [max_name_len];
+	UniformId id = 0;
 	
 	union {
 		HMM_Mat4 mat4;
@@ -43,7 +55,7 @@ struct Uniform {
 	Uniform(const char* name, i32 i);
 	Uniform(const char* name, float32 f);
 };
-bool are_uniforms_equal(Uniform& a, Uniform& b);
+bool are_uniforms_equal(const Uniform& a, const Uniform& b);
 
 enum class GpuShaderKind : u32 {
 	Graphics = 0,
@@ -59,6 +71,11 @@ struct GpuShaderDescriptor {
 	GpuShaderKind kind;
 };
 
+struct GpuUniformLocation {
+	UniformId id;
+	i32 location;
+};
+
 struct GpuShader {
 	enum class Kind : i32 {
 		Graphics,
@@ -67,6 +84,7 @@ struct GpuShader {
 
 	Kind kind;
 	string name;
+	hash_t hash;
 	
 	u32 program = 0;
 	
@@ -78,7 +96,13 @@ struct GpuShader {
 	string compute_path;
 	u32 compute = 0;
 
+	// Every active uniform's location, read back when the program is linked
+	static constexpr u32 max_uniforms = 64;
 	u32 num_uniforms = 0;
+	GpuUniformLocation uniform_locations [max_uniforms];
+
+	// The last value uploaded to each of those uniforms, so that uploading the same value again can be skipped
+	Uniform uniform_values [max_uniforms];
 	
 	static int active;
 
@@ -88,5 +112,8 @@ struct GpuShader {
 	void init_compute(const char* name);
 	void init_compute_ex(const char* name, const char* compute_path);
 	void reload();	
+	void reflect_uniforms();
+	i32 find_uniform_location(UniformId id, const char* name);
+	i32 find_uniform_slot(UniformId id);
 };
 int GpuShader::active = -1;
\ No newline at end of file
@@ -191,10 +191,140 @@ void test_dyn_array() {
 	assert(dyn_array_head(array)->size == 3);
 }
 
+void test_particle_compaction() {
+	ParticleSystem particle_system;
+	particle_system.init();
+	particle_system.max_spawn = ParticleSystem::default_capacity;
+
+	for (i32 i = 0; i < 8; i++) particle_system.spawn_particle();
+	assert(particle_system.num_alive == 8);
+
+	// Tag each particle so we can tell where it ended up
+	auto& particles = particle_system.particles;
+	for (i32 i = 0; i < 8; i++) particles.lifetime[i] = (float)i;
+
+	// Removing from the middle moves the last live particle into the hole
+	particle_system.despawn_particle(2);
+	assert(particle_system.num_alive == 7);
+	assert(particles.lifetime[2] == 7.f);
+
+	// Removing the last particle doesn't move anything
+	particle_system.despawn_particle(6);
+	assert(particle_system.num_alive == 6);
+	assert(particles.lifetime[2] == 7.f);
+	assert(particles.lifetime[5] == 5.f);
+
+	particle_system.deinit();
+}
+
+void test_particle_pool() {
+	auto stats = particle_pool.stats;
+
+	// Capacities are rounded up to a size class
+	assert(ParticlePool::round_capacity(1) == ParticlePool::min_capacity);
+	assert(ParticlePool::round_capacity(100) == 128);
+	assert(ParticlePool::round_capacity(1000000) == ParticlePool::max_capacity);
+
+	// Freed blocks are handed back out for the same size class
+	auto block = particle_pool.alloc(128);
+	particle_pool.free(block, 128);
+	assert(particle_pool.alloc(128) == block);
+	assert(particle_pool.stats.reuses == stats.reuses + 1);
+
+	particle_pool.free(block, 128);
+	assert(particle_pool.stats.bytes_in_use == stats.bytes_in_use);
+}
+
+void test_particle_descriptor() {
+	ParticleSystem particle_system;
+	particle_system.init();
+
+	ParticleSystemDescriptor descriptor;
+	particle_system.read_descriptor(&descriptor);
+	descriptor.particle_kind = ParticleKind::Circle;
+	descriptor.radius = 4.f;
+	descriptor.capacity = 100;
+	descriptor.gravity_enabled = true;
+	particle_system.apply_descriptor(&descriptor);
+
+	// Reading it back gives what was applied, after the capacity is rounded up to its size class
+	ParticleSystemDescriptor applied;
+	particle_system.read_descriptor(&applied);
+	assert(applied.particle_kind == ParticleKind::Circle);
+	assert(applied.radius == 4.f);
+	assert(applied.capacity == 128);
+	assert(particle_system.features & ParticleFeatures::Gravity);
+
+	particle_system.deinit();
+}
+
 void run_tests() {
 	test_bump_allocator();
 	test_dyn_array();
 	test_generational_arena();
 	test_convert_mag();
 	test_convert_point();
+	test_particle_compaction();
+	test_particle_pool();
+	test_particle_descriptor();
+}
+
+#ifdef FM_BENCHMARK
+// Compares update cost at different occupancies. With dense storage, a mostly empty system should cost
+// roughly in proportion to the particles it actually has, not to its capacity.
+void bench_particle_occupancy() {
+	float occupancies [] = { .01f, .1f, 1.f };
+	const i32 frames = 1000;
+
+	for (auto occupancy : occupancies) {
+		ParticleSystem particle_system;
+		particle_system.init();
+
+		// Fill the system up front, and make sure nothing dies or spawns while we're timing
+		auto count = (i32)(ParticleSystem::default_capacity * occupancy);
+		particle_system.max_spawn = count;
+		particle_system.lifetime = 1000000.f;
+		particle_system.warm = true;
+		for (i32 i = 0; i < count; i++) particle_system.spawn_particle();
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (i32 i = 0; i < frames; i++) particle_system.update();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+		tdns_log.write("bench_particle_occupancy: occupancy = %.0f%%, alive = %d, ns/frame = %lld", occupancy * 100, particle_system.num_alive, ns / frames);
+
+		particle_system.deinit();
+	}
+}
+
+// Compares the cost of warming up a system for a few seconds with each warmup mode
+void bench_particle_warmup() {
+	ParticleWarmupMode modes [] = { ParticleWarmupMode::Simulate, ParticleWarmupMode::Scatter };
+	const char* names [] = { "simulate", "scatter" };
+
+	for (i32 i = 0; i < 2; i++) {
+		ParticleSystem particle_system;
+		particle_system.init();
+		particle_system.lifetime = 4.f;
+		particle_system.spawn_rate = 500.f;
+		particle_system.max_spawn = ParticleSystem::default_capacity;
+		particle_system.warmup_iter = 600;
+		particle_system.warmup_mode = modes[i];
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		particle_system.update();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+		tdns_log.write("bench_particle_warmup: mode = %s, alive = %d, us = %lld", names[i], particle_system.num_alive, us);
+
+		particle_system.deinit();
+	}
+}
+
+void run_benchmarks() {
+	bench_particle_occupancy();
+	bench_particle_warmup();
 }
+#endif
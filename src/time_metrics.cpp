@@ -20,6 +20,10 @@ void TimeMetric::begin() {
 void TimeMetric::end() {
 	auto time_end = glfwGetTime();
 	auto delta = time_end - this->time_begin;
+	this->record(delta);
+}
+
+void TimeMetric::record(float64 delta) {
 	rb_push_overwrite(&this->queue, delta);
 }
 
@@ -5,6 +5,7 @@ struct TimeMetric {
 	void init();
 	void begin();
 	void end();
+	void record(double delta);
 	void busy_wait(double target);
 	void sleep_wait(double target);
 	double get_average();
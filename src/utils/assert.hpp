@@ -1,6 +1,12 @@
+#ifdef _WIN32
+	#define fm_debug_break() __debugbreak()
+#else
+	#define fm_debug_break() __builtin_trap()
+#endif
+
 #define fm_assert(expr) do { \
 	if (!(expr)) { \
-		__debugbreak(); \
+		fm_debug_break(); \
 		printf("ASSERT: %s\n", __func__); \
 	} \
 } while (0)
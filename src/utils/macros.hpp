@@ -7,4 +7,15 @@
 
 // All Lua functions have to be declared as extern C! Otherwise, they'll get name mangled,
 // and LuaJIT cannot find them when you declare them with ffi.cdef()
-#define FM_LUA_EXPORT extern "C" __declspec(dllexport)
+// SSE2 is always there on x64; anything else takes the scalar path
+#if defined(_M_X64) || defined(__SSE2__)
+	#define FM_SIMD 1
+#else
+	#define FM_SIMD 0
+#endif
+
+#ifdef _WIN32
+	#define FM_LUA_EXPORT extern "C" __declspec(dllexport)
+#else
+	#define FM_LUA_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
@@ -28,6 +28,19 @@ float32 clamp(float32 value, float32 lower, float32 upper) {
 	return std::min(std::max(value, lower), upper);
 }
 
+// Normalized 8-bit channels, the way unpackUnorm4x8() reads them back on the GPU
+u32 pack_unorm8(float32 value) {
+	return (u32)(clamp(value, 0.f, 1.f) * 255.f + .5f);
+}
+
+u32 pack_rgba8(float32 r, float32 g, float32 b, float32 a) {
+	return pack_unorm8(r) | (pack_unorm8(g) << 8) | (pack_unorm8(b) << 16) | (pack_unorm8(a) << 24);
+}
+
+u32 pack_rgba8(Vector4 color) {
+	return pack_rgba8(color.r, color.g, color.b, color.a);
+}
+
 int32 fm_floor(float32 f) {
 	return static_cast<int32>(floor(f));
 }